@@ -0,0 +1,35 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <ctime>
+#include <cstdint>
+#include <cstddef>
+
+// CPU time budget of the calling thread. It is measured with
+// CLOCK_THREAD_CPUTIME_ID, so time spent by the compression workers or
+// waiting on I/O does not count against it.
+class CpuBudget {
+public:
+    // 0 ms is no budget at all
+    CpuBudget(size_t ms)
+        : m_deadline(ms ? now() + (uint64_t)ms * 1000000 : 0)
+    {
+    }
+
+    bool exceeded() const
+    {
+        return m_deadline && now() > m_deadline;
+    }
+
+private:
+    uint64_t m_deadline;
+
+    static uint64_t now()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+};
+
+#endif
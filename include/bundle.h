@@ -0,0 +1,110 @@
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+#include <string_view>
+
+// Single-file site bundle. Page bodies are appended back to back as they
+// are produced; closing the bundle appends a path string table, an array of
+// fixed-size entries sorted by path and a trailer:
+//
+//   "GGBUNDL1" | bodies... | path strings | entries (8-byte aligned) | trailer
+//
+// All integers are little-endian. Readers map the file and binary search the
+// entry array in place, so a page can be served straight from the mapping
+// (e.g. a gzip body with Content-Encoding: gzip) without copying.
+
+enum class BundleCodec : uint32_t {
+    Raw = 0,
+    Gzip = 1,
+    Zstd = 2,
+};
+
+struct BundleEntry {
+    uint64_t offset;
+    uint64_t size;
+    uint64_t raw_size;
+    uint32_t path_offset;
+    uint32_t path_size;
+    BundleCodec codec;
+    uint32_t reserved;
+};
+
+struct BundleTrailer {
+    uint64_t entries_offset;
+    uint64_t entry_count;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    char magic[8];
+};
+
+class BundleWriter {
+public:
+    BundleWriter(const std::string &path);
+
+    bool is_open() const;
+
+    // thread-safe, a later page with the same path replaces the earlier one
+    bool append(std::string_view path, const char *data, size_t size, size_t raw_size, BundleCodec codec);
+
+    // thread-safe, path will share the body stored for target (which may be
+    // appended later)
+    void alias(std::string_view path, std::string_view target);
+
+    // writes the index and trailer, no appends are allowed afterwards
+    bool close();
+
+private:
+    struct PendingEntry {
+        std::string path;
+        uint64_t offset, size, raw_size;
+        BundleCodec codec;
+    };
+
+    std::ofstream m_out;
+    uint64_t m_offset { 0 };
+    std::vector<PendingEntry> m_entries;
+    std::vector<std::pair<std::string, std::string>> m_aliases;
+    std::mutex m_mutex;
+
+    static std::vector<PendingEntry> sorted_unique(std::vector<PendingEntry> &pending_entries);
+
+    BundleWriter(BundleWriter &&) = delete;
+    BundleWriter(const BundleWriter &) = delete;
+};
+
+class BundleReader {
+public:
+    BundleReader(const std::string &path);
+    ~BundleReader();
+
+    bool is_open() const;
+
+    size_t size() const;
+    const BundleEntry &entry(size_t i) const;
+    std::string_view path(const BundleEntry &entry) const;
+    const BundleEntry *find(std::string_view path) const;
+
+    // stored (possibly compressed) bytes, pointing into the mapping
+    std::string_view body(const BundleEntry &entry) const;
+
+    bool extract(const BundleEntry &entry, std::string &out) const;
+
+private:
+    const char *m_data { nullptr };
+    size_t m_size { 0 };
+    const BundleEntry *m_entries { nullptr };
+    const char *m_strings { nullptr };
+    size_t m_entry_count { 0 };
+
+    bool validate();
+
+    BundleReader(BundleReader &&) = delete;
+    BundleReader(const BundleReader &) = delete;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <string>
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+// On-disk cache of highlighted file views, shared by every run (and every
+// repository) pointed at the same directory. Keys name the content exactly,
+// e.g. a blob id, its language and the highlighter version, so entries
+// never go stale; they are stored as <dir>/<first two key chars>/<key>.
+//
+// Entries are written to a temporary file and renamed into place, so a
+// concurrent run never reads a partial entry. Loading an entry bumps its
+// mtime, which serves as the access time: trim() evicts the least recently
+// used entries until the cache fits in max_bytes.
+class HighlightCache {
+public:
+    static const size_t DEFAULT_MAX_BYTES = 0x100000 * 256; // 256 MiB
+
+    struct Stats {
+        size_t hits = 0, misses = 0, stored = 0, evicted = 0;
+    };
+
+    HighlightCache(const std::string &dir, size_t max_bytes);
+
+    // Replaces out with the entry for key, returning false on a miss.
+    bool load(std::string_view key, std::string &out);
+    bool store(std::string_view key, std::string_view content);
+
+    void trim();
+
+    const Stats &stats() const;
+
+private:
+    std::filesystem::path m_dir;
+    size_t m_max_bytes;
+    Stats m_stats;
+
+    HighlightCache(HighlightCache &&) = delete;
+    HighlightCache(const HighlightCache &) = delete;
+
+    std::filesystem::path entry_path(std::string_view key) const;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef CLASSIFY_H
+#define CLASSIFY_H
+
+#include <string>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <git2.h>
+
+// Files not worth the full rendering: they are shown without highlighting,
+// their diffs as a summary line, and Git LFS pointers as a card.
+enum class ContentClass : uint8_t {
+    Normal,
+    Vendored,
+    Generated,
+    Minified,
+    LfsPointer,
+};
+
+// e.g. "vendored", for "diff of a vendored file"
+const char *content_class_name(ContentClass content_class);
+
+// Line length statistics of a file, or of the lines of its diff.
+class LineStats {
+public:
+    void add(std::string_view line)
+    {
+        m_lines++;
+        m_bytes += line.size();
+        if (line.size() > m_longest)
+            m_longest = line.size();
+    }
+
+    // a few very long lines, as packed JavaScript, CSS or data has
+    bool minified() const;
+
+private:
+    size_t m_lines { 0 };
+    size_t m_bytes { 0 };
+    size_t m_longest { 0 };
+};
+
+struct LfsPointer {
+    std::string_view oid;
+    uint64_t size;
+};
+
+// Git LFS pointers are small files starting with the spec version line.
+static const size_t LFS_POINTER_MAX_SIZE = 1024;
+
+bool is_lfs_pointer(std::string_view content);
+bool parse_lfs_pointer(std::string_view content, LfsPointer &pointer);
+
+// By linguist-generated and linguist-vendored in .gitattributes, then by
+// well known paths. The attributes are those of the working tree, index and
+// HEAD, also for files of older commits. nullopt when neither says anything; Normal when the
+// attributes are explicitly unset, which overrides the content checks.
+std::optional<ContentClass> classify_path(git_repository *repo, const char *path);
+
+// Everything above, for a file whose content is at hand. Only the start of
+// the content is looked at, so this stays cheap for any file size.
+ContentClass classify_file(git_repository *repo, const char *path, std::string_view content);
+
+#endif
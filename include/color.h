@@ -1,9 +1,38 @@
 #ifndef COLOR_H
 #define COLOR_H
 
+#include <memory>
 #include <string>
-#include <iostream>
+#include <string_view>
 
-void highlight(const std::string &filename, std::istream &in, std::ostream &out);
+// Bumped whenever the markup produced for the same input changes.
+static const unsigned COLOR_VERSION = 1;
+
+struct ColorState;
+
+// source-highlight, for the files the built-in lexers do not cover. Lines
+// are fed in order, like Highlighter, and come out escaped with tokens in
+// the same <span class=".."> markup. The parsed language definitions are
+// kept per thread and built once per language, so a highlighter is cheap
+// to create; it must be used on the thread that created it.
+class ColorHighlighter {
+public:
+    // nullptr when source-highlight has no language for filename
+    static std::unique_ptr<ColorHighlighter> create(const std::string &filename);
+    ~ColorHighlighter();
+
+    // the language definition file, e.g. "cpp.lang"
+    const std::string &lang() const;
+
+    void highlight_line(std::string &out, std::string_view line);
+
+private:
+    std::unique_ptr<ColorState> m_state;
+
+    ColorHighlighter(std::unique_ptr<ColorState> state);
+
+    ColorHighlighter(ColorHighlighter &&) = delete;
+    ColorHighlighter(const ColorHighlighter &) = delete;
+};
 
 #endif
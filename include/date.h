@@ -0,0 +1,28 @@
+#ifndef DATE_H
+#define DATE_H
+
+#include <string>
+#include <cstdint>
+
+// Formats commit times as "YYYY-MM-DD HH:MM", either in the commit's own
+// timezone (from its git_time offset) or in UTC. Dates are computed from
+// the epoch directly, without localtime() or its global timezone lock, and
+// the "YYYY-MM-DD" prefix is cached since consecutive commits tend to share
+// a day. A formatter is not shared between threads; each generator owns one.
+class DateFormatter {
+public:
+    explicit DateFormatter(bool utc = false);
+
+    // time in seconds since the epoch, offset in minutes east of UTC
+    void format(std::string &out, int64_t time, int offset) const;
+    std::string format(int64_t time, int offset) const;
+
+private:
+    bool m_utc;
+
+    mutable int64_t m_cached_day;
+    mutable char m_day_prefix[32];
+    mutable size_t m_day_prefix_size { 0 };
+};
+
+#endif
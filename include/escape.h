@@ -0,0 +1,17 @@
+#ifndef ESCAPE_H
+#define ESCAPE_H
+
+#include <string>
+#include <string_view>
+
+// Appends str to out with &, <, >, " and ' replaced by HTML entities. Clean
+// runs are found 16 (SSE2) or 32 (AVX2, picked at runtime) bytes at a time
+// and copied in bulk.
+void escape_html(std::string &out, const char *str, size_t len);
+
+inline void escape_html(std::string &out, std::string_view str)
+{
+    escape_html(out, str.data(), str.size());
+}
+
+#endif
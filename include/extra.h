@@ -5,27 +5,17 @@
 #include <string>
 #include <git2.h>
 #include <git2/global.h>
+#include "escape.h"
 
 #define GiB 0x40000000
 #define MiB 0x100000
 #define KiB 0x400
 
-inline std::string escape_string(const std::string &str)
+inline std::string escape_string(std::string_view str)
 {
     std::string out;
     out.reserve(str.length());
-
-    for (size_t i = 0; i < str.size(); i++) {
-        switch (str[i]) {
-        case '&':   out.append("&amp;");    break;
-        case '<':   out.append("&lt;");     break;
-        case '>':   out.append("&gt;");     break;
-        case '"':   out.append("&quot;");   break;
-        case '\'':  out.append("&#39;");    break;
-        default:    out.append(&str[i], 1); break;
-        }
-    }
-
+    escape_html(out, str);
     return out;
 }
 
@@ -63,11 +53,4 @@ inline void to_lowercase(std::string &str)
             str.begin(), lowercase);
 }
 
-inline std::string to_string(git_time_t time)
-{
-    std::stringstream sstream;
-    sstream << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M");
-    return sstream.str();
-}
-
 #endif
@@ -0,0 +1,88 @@
+#ifndef HIGHLIGHT_H
+#define HIGHLIGHT_H
+
+#include <string>
+#include <cstdint>
+#include <string_view>
+
+// Bumped whenever the markup produced for the same input changes.
+static const unsigned HIGHLIGHTER_VERSION = 2;
+
+struct Language;
+enum class Token : uint8_t;
+
+// A span of a line to wrap in extra markup, such as the changed part of a
+// line in a diff. Offsets are into the line's text.
+struct LineMark {
+    size_t begin;
+    size_t end;
+    std::string_view open;
+    std::string_view close;
+};
+
+// The built-in lexer for a file, picked by its name or, failing that, by the
+// interpreter on its "#!" line. Returns nullptr when none applies.
+const Language *find_language(std::string_view filename, std::string_view content);
+
+// short stable name of a language, e.g. "c" or "python"
+const char *language_name(const Language &lang);
+
+// Table-driven highlighter for the built-in languages. Lines are fed in
+// order and each comes out escaped, with its tokens wrapped in
+// <span class="..">. Spans never cross lines: a comment or string that
+// spans several is closed at the end of each line and reopened on the next,
+// so any line markup can go around the output. Everything is done in one
+// linear pass over each line. A token crossing a LineMark is split at its
+// edges, so the mark nests within the spans.
+class Highlighter {
+public:
+    Highlighter(const Language &lang)
+        : m_lang(lang)
+    {
+    }
+
+    void highlight_line(std::string &out, std::string_view line, const LineMark *mark = nullptr);
+
+    // Lexer state between lines, so that two highlighters following the
+    // same text (like both sides of a diff) can skip lexing it twice.
+    bool same_state(const Highlighter &other) const
+    {
+        return m_state == other.m_state && m_quote == other.m_quote && m_triple == other.m_triple
+            && m_raw_close == other.m_raw_close;
+    }
+
+    void copy_state(const Highlighter &other)
+    {
+        m_state = other.m_state;
+        m_quote = other.m_quote;
+        m_triple = other.m_triple;
+        m_raw_close = other.m_raw_close;
+    }
+
+private:
+    enum class State : uint8_t {
+        Code,
+        Comment,    // inside a block comment
+        String,     // inside a string spanning lines
+    };
+
+    const Language &m_lang;
+
+    State m_state { State::Code };
+    char m_quote { 0 };
+    bool m_triple { false };
+    // what closes the raw string being lexed, e.g. )x" or "##, empty for
+    // ordinary strings
+    std::string m_raw_close;
+
+    // the line being highlighted and its mark, if any
+    const char *m_line { nullptr };
+    const LineMark *m_mark { nullptr };
+
+    void write(std::string &out, Token token, const char *begin, const char *end) const;
+
+    const char *string_end(const char *p, const char *end) const;
+    const char *continue_line(std::string &out, const char *p, const char *end);
+};
+
+#endif
@@ -4,11 +4,15 @@
 #include <string>
 #include <vector>
 #include <filesystem>
+#include "output.h"
+#include "date.h"
 
 class IndexHtmlGen {
 public:
     struct Options {
         std::vector<std::string> repo_paths;
+        bool utc { false }; // dates in UTC rather than each commit's timezone
+        OutputWriter::Options output;
     };
 
     IndexHtmlGen(const Options &opt);
@@ -18,6 +22,8 @@ public:
 
 private:
     Options m_options;
+    OutputWriter m_output;
+    DateFormatter m_dates;
 
     void cleanup();
     void error(const char *msg);
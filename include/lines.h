@@ -0,0 +1,73 @@
+#ifndef LINES_H
+#define LINES_H
+
+#include <cstring>
+#include <algorithm>
+#include <string_view>
+
+// Splits a buffer into lines in place, using memchr to find each newline.
+// Lines come out without their "\n" or "\r\n"; a last line without a
+// trailing newline is still a line, and an empty buffer has none.
+class LineReader {
+public:
+    LineReader(const char *data, size_t size)
+        : m_pos(data),
+          m_end(data + size)
+    {
+    }
+
+    bool next(std::string_view &line)
+    {
+        if (m_pos == m_end)
+            return false;
+
+        const char *newline = (const char *)memchr(m_pos, '\n', m_end - m_pos);
+        const char *line_end = newline ? newline : m_end;
+
+        size_t len = line_end - m_pos;
+        if (len && m_pos[len - 1] == '\r')
+            len--;
+        line = std::string_view(m_pos, len);
+
+        m_pos = newline ? newline + 1 : m_end;
+        m_line_no++;
+        return true;
+    }
+
+    // number of lines returned so far
+    size_t line_no() const
+    {
+        return m_line_no;
+    }
+
+private:
+    const char *m_pos;
+    const char *m_end;
+    size_t m_line_no { 0 };
+};
+
+// Number of lines LineReader would return for the buffer.
+inline size_t count_lines(const char *data, size_t size)
+{
+    if (!size)
+        return 0;
+
+    size_t newlines = std::count(data, data + size, '\n');
+    return newlines + (data[size - 1] != '\n');
+}
+
+// Length of the longest line in the buffer, newline excluded.
+inline size_t longest_line(const char *data, size_t size)
+{
+    size_t longest = 0;
+    const char *end = data + size;
+    while (data < end) {
+        const char *newline = (const char *)memchr(data, '\n', end - data);
+        const char *line_end = newline ? newline : end;
+        longest = std::max<size_t>(longest, line_end - data);
+        data = line_end + 1;
+    }
+    return longest;
+}
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <string_view>
+
+// List of output paths (relative to public/) with their content hash and
+// size, one "<xxh64> <size> <path>" line per path, sorted by path.
+class Manifest {
+public:
+    struct Entry {
+        std::string path;
+        uint64_t hash;
+        uint64_t size;
+    };
+
+    // thread-safe
+    void add(std::string path, uint64_t hash, uint64_t size);
+
+    bool load(const std::string &path);
+    bool save(const std::string &path);
+
+    // writes "<A|M|D> <xxh64> <path>" lines for everything that differs
+    // from the previous manifest
+    bool save_changes(const Manifest &previous, const std::string &path);
+
+    // only valid on a loaded or saved (i.e. sorted) manifest
+    const Entry *find(std::string_view path) const;
+
+    const std::vector<Entry> &entries() const;
+
+private:
+    std::vector<Entry> m_entries;
+    std::mutex m_mutex;
+
+    void sort();
+};
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef MINIFY_H
+#define MINIFY_H
+
+#include <string>
+#include <cstddef>
+
+// Single-pass HTML minifier. Outside of pre, textarea, script and style
+// elements every run of whitespace is collapsed to one character (a newline
+// if the run had one), or dropped entirely when it only separates two tags
+// and one of them is a block-level element; comments are dropped too. Inside
+// a tag, whitespace is collapsed outside of quoted attribute values. Raw
+// elements are copied verbatim.
+//
+// The minifier is a state machine fed in chunks of any size. It never emits
+// more than it has consumed, so it can run in place: feed() may be given
+// out == in (or any out before in), which is how minify_html() works.
+class HtmlMinifier {
+public:
+    // Consumes len bytes of in and writes the minified bytes to out,
+    // returning the end of what was written. The start of a tag or comment
+    // (at most MAX_NAME + 2 bytes) may be held back until the next feed() or
+    // finish().
+    char *feed(const char *in, size_t len, char *out);
+    char *finish(char *out);
+
+private:
+    enum class State {
+        Text,
+        TagOpen,    // after '<', deciding between a comment and a tag
+        TagName,
+        Tag,
+        Comment,
+        Raw,        // inside pre, textarea, script or style
+    };
+
+    static const size_t MAX_NAME = 8;
+
+    State m_state { State::Text };
+
+    // whitespace seen but not yet written, and whether it held a newline
+    bool m_space { false };
+    bool m_newline { false };
+
+    // the "<", "<!" or "<!-" read so far in TagOpen
+    size_t m_open { 0 };
+
+    // lowercase tag name read so far, and whether it is a closing tag
+    char m_name[MAX_NAME + 1] {};
+    size_t m_name_size { 0 };
+    bool m_closing { false };
+
+    // "<", "/" and the name as written, held back until the name is known
+    // so that whitespace before a block-level tag can still be dropped
+    char m_held[MAX_NAME + 2] {};
+    size_t m_held_size { 0 };
+
+    // nothing but whitespace since the last tag, and whether it was a
+    // block-level one (the start of the page counts as one)
+    bool m_after_tag { true };
+    bool m_after_block { true };
+    bool m_block { false };
+
+    char m_quote { 0 };
+    size_t m_dashes { 0 };
+
+    // which raw element is open and how much of its "</name" is matched; a
+    // full match still waits for the character after the name
+    const char *m_raw_end { nullptr };
+    size_t m_raw_matched { 0 };
+
+    char *flush_space(char *out);
+    char *flush_open(char *out, size_t count);
+    char *flush_held(char *out, bool block);
+};
+
+// Minifies a complete page in place.
+void minify_html(std::string &html);
+
+#endif
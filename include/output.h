@@ -0,0 +1,220 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <filesystem>
+#include <condition_variable>
+#include "bundle.h"
+#include "manifest.h"
+
+// what a written file is, for per-kind output accounting
+enum class PageKind {
+    File,
+    Tree,
+    Commit,
+    Index,
+    Raw,
+    Count,
+};
+
+const char *page_kind_name(PageKind kind);
+
+// Writes generated pages to disk. Pages are handed over as complete in-memory
+// buffers; optional .gz/.zst siblings are compressed from those buffers on
+// worker threads so the generator never has to wait for compression.
+//
+// In bundle mode pages go into a single BundleWriter file instead, keyed by
+// their path below public/ and compressed on the same workers.
+//
+// A page whose bytes match the existing file is not rewritten, so its mtime
+// and any compressed siblings are left alone. The previous manifest, when
+// there is one, serves as the hash index; otherwise the file is read back
+// and compared.
+//
+// Content-addressed objects are written once with write_object() and can be
+// given further names with link(): hardlinks (or relative symlinks) on disk,
+// aliases of the same body in a bundle.
+//
+// With minify set, pages are minified in place (see HtmlMinifier) before
+// anything else looks at them.
+//
+// Every byte that ends up in the output (written or left unchanged) is
+// accounted to its PageKind. With a byte budget set, pages are accounted
+// as they are written: write_if_fits() checks and accounts a page under one
+// lock, and the generator asks fits() or available() before adding other
+// optional content. Compressed siblings only get what is left: they are
+// written as they are compressed but accounted in finish(), in the order
+// of their pages, and the ones that no longer fit are removed again.
+//
+// With a manifest path set, every path written (siblings included) is
+// recorded with its hash, and finish() writes the new manifest plus a
+// "<manifest>.changes" list of paths added, modified or deleted since the
+// manifest left by the previous run.
+class OutputWriter {
+public:
+    static const int DEFAULT_GZIP_LEVEL = 6;
+    static const int DEFAULT_ZSTD_LEVEL = 3;
+    static const size_t DEFAULT_COMPRESS_MIN_SIZE = 0x400; // 1 KiB
+
+    struct Options {
+        bool gzip { false };
+        bool zstd { false };
+        int gzip_level { DEFAULT_GZIP_LEVEL };
+        int zstd_level { DEFAULT_ZSTD_LEVEL };
+        size_t compress_min_size { DEFAULT_COMPRESS_MIN_SIZE };
+        size_t jobs { 0 }; // 0: one worker per hardware thread
+        std::string bundle_path;
+        std::string manifest_path;
+        bool symlinks { false }; // link() makes relative symlinks, not hardlinks
+        size_t max_bytes { 0 }; // 0: unlimited
+        bool minify { false };
+    };
+
+    struct Stats {
+        std::atomic<size_t> files_written { 0 };
+        std::atomic<size_t> files_skipped { 0 };
+        std::atomic<size_t> files_removed { 0 };
+        std::atomic<size_t> links_written { 0 };
+        std::atomic<size_t> bytes_written { 0 };
+        std::atomic<size_t> bytes_skipped { 0 };
+        std::atomic<size_t> siblings_dropped { 0 };
+        std::atomic<size_t> kind_bytes[(size_t)PageKind::Count] {};
+    };
+
+    OutputWriter(const Options &opt);
+    ~OutputWriter();
+
+    bool bundling() const;
+
+    // files below dir that are not written again before finish() are removed
+    void own_dir(const std::filesystem::path &dir);
+
+    // returns false if the page could not be written
+    bool write(const std::filesystem::path &path, std::string &&content, PageKind kind);
+
+    // Like write(), but only if the page fits in what is left of the budget.
+    // Otherwise over_budget is set and nothing is written, so the caller can
+    // write something smaller instead.
+    bool write_if_fits(const std::filesystem::path &path, std::string &content, PageKind kind, bool &over_budget);
+
+    // writes data to path unless it is already there, path must be unique to
+    // the content (e.g. named after the blob id)
+    bool write_object(const std::filesystem::path &path, const char *data, size_t size, PageKind kind);
+
+    // makes path another name for an object written with write_object()
+    bool link(const std::filesystem::path &path, const std::filesystem::path &object_path);
+
+    // waits for outstanding compression jobs, returns false if any failed;
+    // jobs of pages written after this run on the calling thread
+    bool finish();
+
+    // stops the workers, dropping queued jobs, for error paths that exit
+    // without finish()
+    void abandon();
+
+    const Stats &stats() const;
+
+    // total bytes accounted so far
+    size_t output_bytes() const;
+    // whether bytes more would stay within the budget
+    bool fits(size_t bytes) const;
+    // bytes left in the budget, SIZE_MAX when unlimited
+    size_t available() const;
+
+private:
+    Options m_options;
+
+    std::filesystem::path m_last_dir;
+    std::unique_ptr<BundleWriter> m_bundle;
+    Manifest m_manifest;
+    Manifest m_previous;
+    Stats m_stats;
+
+    struct ObjectInfo {
+        uint64_t hash;
+        size_t size;
+        PageKind kind;
+    };
+    std::unordered_map<std::string, ObjectInfo> m_objects;
+
+    std::vector<std::filesystem::path> m_owned_dirs;
+    std::unordered_set<std::string> m_written;
+    std::mutex m_written_mutex;
+
+    // guards the budget accounting, so a check and the bytes it lets in
+    // are one step; m_reserved holds pages let in but not yet accounted
+    mutable std::mutex m_budget_mutex;
+    size_t m_reserved { 0 };
+
+    // compressed siblings, accounted only in finish()
+    struct Sibling {
+        size_t order;
+        std::filesystem::path path;
+        PageKind kind;
+        size_t size;
+        uint64_t hash;
+        bool unchanged; // kept from an earlier run, for an unchanged page
+    };
+    std::vector<Sibling> m_siblings;
+    std::mutex m_siblings_mutex;
+    size_t m_sibling_count { 0 };
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_jobs_mutex;
+    std::condition_variable m_jobs_cv;
+    std::condition_variable m_space_cv;
+    size_t m_max_jobs { 0 };
+    bool m_stop { false };
+    std::atomic<bool> m_failed { false };
+
+    OutputWriter(OutputWriter &&) = delete;
+    OutputWriter(const OutputWriter &) = delete;
+
+    bool compressing() const;
+    bool manifesting() const;
+    void start_workers();
+    void stop_workers();
+    void worker();
+    void enqueue(std::function<void()> &&job);
+
+    bool make_parent_dirs(const std::filesystem::path &path);
+    void mark_written(const std::filesystem::path &path);
+    bool prune_owned_dirs();
+
+    void record(const std::filesystem::path &path, uint64_t hash, size_t size);
+    bool save_manifest();
+
+    bool unchanged(const std::filesystem::path &path, uint64_t hash, const char *data, size_t size);
+    void account(PageKind kind, size_t size);
+    void settle(PageKind kind, size_t reserved, size_t size);
+    size_t used_bytes() const;
+    void settle_siblings();
+    bool keep_unchanged(const std::filesystem::path &path, PageKind kind);
+    bool write_changed(const std::filesystem::path &path, const char *data, size_t size, uint64_t hash, PageKind kind);
+    bool write_bundled(const std::filesystem::path &path, std::string &&content, PageKind kind);
+    bool write_page(const std::filesystem::path &path, std::string &&content, PageKind kind);
+    void write_sibling(const std::filesystem::path &path, PageKind kind, bool page_unchanged,
+            const std::shared_ptr<const std::string> &content,
+            bool (*compress)(const char *, size_t, int, std::string &), int level);
+};
+
+bool write_file(const std::filesystem::path &path, const char *data, size_t size);
+
+bool gzip_compress(const char *data, size_t size, int level, std::string &out);
+bool gzip_decompress(const char *data, size_t size, size_t raw_size, std::string &out);
+#ifdef ZSTD
+bool zstd_compress(const char *data, size_t size, int level, std::string &out);
+bool zstd_decompress(const char *data, size_t size, size_t raw_size, std::string &out);
+#endif
+
+#endif
@@ -0,0 +1,233 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <span>
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <concepts>
+#include <string_view>
+
+// A page or row template is parsed once into a flat list of ops. Each op
+// copies a literal chunk of the template source and then, unless arg is
+// NO_ARG, appends the argument bound to that slot. Slots are named like
+// fmt named arguments ({name}) and braces are escaped as {{ and }}.
+struct TemplateOp {
+    static constexpr uint32_t NO_ARG = UINT32_MAX;
+
+    uint32_t offset;
+    uint32_t size;
+    uint32_t arg;
+};
+
+// A string, a number, or a writer: a callable taking std::string & that
+// appends the content in place when its slot is reached, so nested views
+// and large bodies go straight into the page buffer.
+class TemplateArg {
+public:
+    TemplateArg(std::string_view str)
+        : m_str(str)
+    {
+    }
+
+    TemplateArg(const std::string &str)
+        : m_str(str)
+    {
+    }
+
+    TemplateArg(const char *str)
+        : m_str(str)
+    {
+    }
+
+    template <std::integral T>
+    TemplateArg(T number)
+        : m_kind(Kind::Number),
+          m_number(number)
+    {
+    }
+
+    template <std::invocable<std::string &> F>
+    TemplateArg(const F &writer)
+        : m_kind(Kind::Writer),
+          m_writer(&writer),
+          m_write([](const void *writer, std::string &out) { (*(const F *)writer)(out); })
+    {
+    }
+
+    void append_to(std::string &out) const;
+
+private:
+    enum class Kind : uint8_t { String, Number, Writer };
+
+    Kind m_kind { Kind::String };
+    std::string_view m_str;
+    uint64_t m_number { 0 };
+    const void *m_writer { nullptr };
+    void (*m_write)(const void *, std::string &) { nullptr };
+};
+
+// Parses source, calling emit(op) for every op. Slot names are resolved to
+// their index in names. Returns nullptr on success or a description of the
+// first error.
+template <size_t N, typename Emit>
+constexpr const char *parse_template(std::string_view source,
+        const std::array<std::string_view, N> &names, Emit &&emit)
+{
+    size_t literal_start = 0;
+    size_t pos = 0;
+
+    auto literal = [&](size_t end, uint32_t arg) {
+        emit(TemplateOp { (uint32_t)literal_start, (uint32_t)(end - literal_start), arg });
+    };
+
+    while (pos < source.size()) {
+        char c = source[pos];
+        if (c == '}') {
+            if (pos + 1 >= source.size() || source[pos + 1] != '}')
+                return "unmatched '}'";
+            // keep one brace, skip the other
+            literal(pos + 1, TemplateOp::NO_ARG);
+            literal_start = pos += 2;
+            continue;
+        }
+        if (c != '{') {
+            pos++;
+            continue;
+        }
+        if (pos + 1 < source.size() && source[pos + 1] == '{') {
+            literal(pos + 1, TemplateOp::NO_ARG);
+            literal_start = pos += 2;
+            continue;
+        }
+
+        size_t name_end = source.find('}', pos);
+        if (name_end == std::string_view::npos)
+            return "unterminated '{'";
+
+        std::string_view name = source.substr(pos + 1, name_end - pos - 1);
+        size_t arg = 0;
+        while (arg < N && names[arg] != name)
+            arg++;
+        if (arg == N)
+            return "unknown template argument";
+
+        literal(pos, (uint32_t)arg);
+        literal_start = pos = name_end + 1;
+    }
+
+    if (literal_start < source.size())
+        literal(source.size(), TemplateOp::NO_ARG);
+
+    return nullptr;
+}
+
+template <size_t N>
+consteval size_t count_template_ops(std::string_view source, const std::array<std::string_view, N> &names)
+{
+    size_t count = 0;
+    if (parse_template(source, names, [&](TemplateOp) { count++; }))
+        throw "invalid template";
+    return count;
+}
+
+template <size_t OPS, size_t N>
+consteval std::array<TemplateOp, OPS> compile_template(std::string_view source,
+        const std::array<std::string_view, N> &names)
+{
+    std::array<TemplateOp, OPS> ops {};
+    size_t i = 0;
+    if (parse_template(source, names, [&](TemplateOp op) { ops[i++] = op; }))
+        throw "invalid template";
+    return ops;
+}
+
+void render_template(std::string &out, std::string_view source,
+        std::span<const TemplateOp> ops, const TemplateArg *args);
+
+// Source and ops of a template compiled at runtime. These live until exit,
+// since templates are only loaded once at startup.
+struct CompiledTemplate {
+    std::string source;
+    std::vector<TemplateOp> ops;
+};
+
+CompiledTemplate &new_compiled_template();
+
+// Source text and argument names of a built-in template.
+template <size_t N>
+struct TemplateDef {
+    std::string_view source;
+    std::array<std::string_view, N> names;
+};
+
+template <const auto &Def>
+inline constexpr auto compiled_template_ops =
+    compile_template<count_template_ops(Def.source, Def.names)>(Def.source, Def.names);
+
+// Template taking N arguments, passed to render() in the order of the
+// names it was declared with.
+template <size_t N>
+class Template {
+public:
+    constexpr Template(std::string_view source, std::span<const TemplateOp> ops,
+            const std::array<std::string_view, N> &names)
+        : m_source(source),
+          m_ops(ops),
+          m_names(&names)
+    {
+    }
+
+    // Replaces the template with source, compiled against the same argument
+    // names so that call sites stay bound to the same indices. Returns
+    // nullptr on success or a description of the error.
+    const char *load(std::string source)
+    {
+        CompiledTemplate &compiled = new_compiled_template();
+        compiled.source = std::move(source);
+
+        const char *err = parse_template(compiled.source, *m_names,
+                [&](TemplateOp op) { compiled.ops.push_back(op); });
+        if (err)
+            return err;
+
+        m_source = compiled.source;
+        m_ops = compiled.ops;
+        return nullptr;
+    }
+
+    void render(std::string &out, const TemplateArg (&args)[N]) const
+    {
+        render_template(out, m_source, m_ops, args);
+    }
+
+    std::string format(const TemplateArg (&args)[N]) const
+    {
+        std::string out;
+        render(out, args);
+        return out;
+    }
+
+    // bytes of literal text, for reserving output ahead of rendering
+    size_t literal_size() const
+    {
+        size_t size = 0;
+        for (auto &op : m_ops)
+            size += op.size;
+        return size;
+    }
+
+private:
+    std::string_view m_source;
+    std::span<const TemplateOp> m_ops;
+    const std::array<std::string_view, N> *m_names;
+};
+
+template <const auto &Def>
+constexpr auto make_template()
+{
+    return Template<Def.names.size()>(Def.source, compiled_template_ops<Def>, Def.names);
+}
+
+#endif
@@ -2,24 +2,50 @@
 #define REPO_H
 
 #include <string>
+#include <memory>
+#include <functional>
 #include <vector>
 #include <filesystem>
+#include <unordered_set>
 #include <git2.h>
 #include <git2/global.h>
 
 #include "fmt/format.h"
+#include "output.h"
+#include "templates.h"
+#include "date.h"
+#include "cache.h"
+#include "budget.h"
+#include "highlight.h"
+#include "classify.h"
 
 class RepoHtmlGen {
 public:
     static const size_t DEFAULT_MAX_COMMITS = 128;
     static const size_t DEFAULT_MAX_DIFF_LINES = 1024;
     static const size_t DEFAULT_MAX_VIEW_FILESIZE = 0x400 * 512; // 512 KiB
+    static const size_t DEFAULT_VIEW_CHUNK_LINES = 2000;
+    static const size_t DEFAULT_MAX_CHUNKED_FILESIZE = 0x100000 * 32; // 32 MiB
+    static const size_t DEFAULT_HIGHLIGHT_BUDGET_MS = 1000;
 
     struct Options {
         std::string repo_path;
         size_t max_commits { DEFAULT_MAX_COMMITS };
         size_t max_diff_lines { DEFAULT_MAX_DIFF_LINES };
         size_t max_view_filesize { DEFAULT_MAX_VIEW_FILESIZE };
+        size_t view_chunk_lines { DEFAULT_VIEW_CHUNK_LINES }; // lines per page of larger files, 0: no chunked view
+        size_t max_chunked_filesize { DEFAULT_MAX_CHUNKED_FILESIZE }; // no chunked view from this size, 0: no limit
+        bool stats { false };
+        bool raw { false };
+        bool compact { false };
+        bool split_diffs { false }; // side-by-side commit pages next to the unified ones
+        bool classify { false }; // cheap rendering of vendored, generated, minified and LFS files
+        bool highlight { false }; // built-in syntax highlighting
+        std::string highlight_cache; // directory of the highlight cache, if any
+        size_t highlight_cache_max_bytes { HighlightCache::DEFAULT_MAX_BYTES };
+        size_t highlight_budget_ms { DEFAULT_HIGHLIGHT_BUDGET_MS }; // CPU time per file, 0: unlimited
+        bool utc { false }; // dates in UTC rather than each commit's timezone
+        OutputWriter::Options output;
     };
 
     RepoHtmlGen(const Options &opt);
@@ -29,6 +55,9 @@ public:
 
 private:
     Options m_options;
+    OutputWriter m_output;
+    DateFormatter m_dates;
+    std::unique_ptr<HighlightCache> m_highlight_cache;
 
     const git_oid *m_head { nullptr };
     git_commit *m_head_commit { nullptr};
@@ -44,23 +73,52 @@ private:
 
     std::string m_readme_content;
 
+    // optional content left out to stay within the output or time budget
+    struct Degraded {
+        size_t files = 0, diffs = 0, raw = 0;
+        size_t highlight = 0; // files over the highlighting time budget
+    } m_degraded;
+
+    // paths exported as raw/files/<path>, the only ones pages link to
+    std::unordered_set<std::string> m_raw_files;
+
+    // views and diffs given the cheap rendering by classify
+    struct Classified {
+        size_t files = 0, diffs = 0;
+    } m_classified;
+
     RepoHtmlGen(RepoHtmlGen &&) = delete;
     RepoHtmlGen(const RepoHtmlGen &) = delete;
 
     void cleanup();
     void error(const char *msg);
 
+    void print_stats() const;
+
     const git_oid *head() const;
     void find_readme();
 
-    void generate_file_code_page(const std::string &filename, git_blob *blob, std::string &html);
+    const Template<5> &file_view() const;
+
+    // appends one line highlighted, in the order of the file
+    using LineHighlighter = std::function<void(std::string &, std::string_view)>;
+
+    bool highlight_file_code(std::string_view cache_name, const LineHighlighter &highlight_line, git_blob *blob,
+        const CpuBudget &budget, std::string &html);
+    void generate_file_code_page(const std::string &filename, git_blob *blob, std::string &html, bool allow_highlight);
+    void generate_file_chunk_pages(const std::filesystem::path &file_path, const char *filename, git_blob *blob,
+        bool allow_highlight);
     void generate_file_page(const std::filesystem::path &file_path, const git_tree_entry *entry);
     void generate_file_pages();
     void generate_tree_pages(git_tree *tree, std::string root = "");
 
+    std::string raw_link(const std::filesystem::path &file_path) const;
+    void generate_raw_files(git_tree *tree, std::unordered_set<std::string> &exported, std::string root = "");
+
     struct Delta {
         git_patch *patch;
         size_t gain, loss;
+        ContentClass content_class { ContentClass::Normal };
     };
 
     struct CommitInfo {
@@ -72,6 +130,7 @@ private:
         git_tree *tree;
         git_tree *parent_tree;
         git_time_t time;
+        int time_offset;
         const char *summary;
         const char *message;
         const git_oid *id;
@@ -85,6 +144,7 @@ private:
         std::vector<Delta> deltas;
     };
 
+    bool is_lfs_delta(const git_diff_delta *delta);
     void get_commit_info(git_commit *commit, CommitInfo &info);
     void generate_commit_page(const CommitInfo &commit);
     void generate_commit_pages();
@@ -1,17 +1,31 @@
 #ifndef TEMPLATES_H
 #define TEMPLATES_H
 
-extern const char *header_template;
-extern const char *file_page_template;
-extern const char *file_view_template;
-extern const char *file_line_template;
-extern const char *file_index_template;
-extern const char *file_tree_line_template;
-extern const char *file_tree_line_dir_template;
-
-extern const char *commits_page_template;
-extern const char *commit_page_template;
-extern const char *commits_line_template;
+#include <string>
+#include "render.h"
+
+// Templates are rendered with their arguments in the order listed next to
+// each declaration.
+
+extern Template<4> header_template; // repo_name, repo_desc, files_path, commits_path
+extern Template<4> file_page_template; // header_content, repo_name, filename, fileview_content
+extern Template<5> file_view_template; // filename, raw_link, file_content, file_size, file_size_unit
+extern Template<5> file_view_compact_template; // filename, raw_link, file_content, file_size, file_size_unit
+extern Template<2> file_line_template; // line_no, line
+extern Template<2> file_line_compact_template; // line_no, line
+extern Template<7> file_chunk_view_template; // filename, raw_link, chunk_nav, file_content, file_size, file_size_unit, line_offset
+extern Template<7> file_chunk_view_compact_template; // filename, raw_link, chunk_nav, file_content, file_size, file_size_unit, line_offset
+extern Template<4> file_chunk_nav_template; // links, first, last, lines
+extern Template<2> file_chunk_link_template; // link, label
+extern Template<3> file_lfs_card_template; // oid, size, size_unit
+extern Template<1> file_raw_link_template; // raw_path
+extern Template<5> file_index_template; // repo_name, header_content, readme_content, tree_content, tree_path
+extern Template<4> file_tree_line_template; // file_tree_name, file_tree_size, file_tree_size_unit, file_tree_link
+extern Template<2> file_tree_line_dir_template; // file_tree_name, file_tree_link
+
+extern Template<3> commits_page_template; // repo_name, header_content, commits_content
+extern Template<9> commit_page_template; // repo_name, header_content, date, message, author, email, commit, parent, diff_content
+extern Template<7> commits_line_template; // files, gain, loss, commit_link, date, author, summary
 
 extern const char *diff_line_template;
 extern const char *diff_add_template;
@@ -20,12 +34,29 @@ extern const char *diff_add_eofnl_template;
 extern const char *diff_del_eofnl_template;
 extern const char *diff_file_hdr_template;
 extern const char *diff_hunk_hdr_template;
+extern const char *diff_hunk_compact_template;
+extern const char *diff_add_run_template;
+extern const char *diff_del_run_template;
+extern const char *diff_changed_template;
+extern const char *diff_split_begin;
+extern const char *diff_split_end;
+extern Template<6> diff_split_row_template; // old_no, old_kind, old_line, new_no, new_kind, new_line
+extern Template<2> diff_split_hunk_hdr_template; // hunk, header
+extern Template<2> diff_view_link_template; // link, label
+extern Template<3> diff_summary_template; // kind, gain, loss
 extern const char *diff_max_line_count;
+extern const char *diff_budget_reached;
+extern const char *budget_file_omitted;
 
-extern const char *index_page_template;
-extern const char *index_line_template;
+extern Template<1> index_page_template; // repos_content
+extern Template<3> index_line_template; // name, desc, updated
 
 extern const char *markdown_pre;
 extern const char *markdown_post;
 
+// Replaces page and row templates with <name>.html files found in dir,
+// e.g. header.html or commits_line.html. Templates without a file keep the
+// built-in version.
+bool load_templates(const std::string &dir);
+
 #endif
@@ -0,0 +1,267 @@
+#include <bit>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bundle.h"
+#include "output.h"
+
+static_assert(std::endian::native == std::endian::little, "bundle format is little-endian");
+static_assert(sizeof(BundleEntry) == 40 && sizeof(BundleTrailer) == 40);
+
+static const char BUNDLE_MAGIC[8] = { 'G', 'G', 'B', 'U', 'N', 'D', 'L', '1' };
+
+// no page comes near this, a larger raw size means a corrupt entry
+static const uint64_t MAX_RAW_SIZE = 0x40000000; // 1 GiB
+
+BundleWriter::BundleWriter(const std::string &path)
+    : m_out(path, std::ios::out | std::ios::binary | std::ios::trunc)
+{
+    m_out.write(BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC));
+    m_offset = sizeof(BUNDLE_MAGIC);
+}
+
+bool BundleWriter::is_open() const
+{
+    return m_out.is_open();
+}
+
+bool BundleWriter::append(std::string_view path, const char *data, size_t size, size_t raw_size, BundleCodec codec)
+{
+    std::lock_guard lock(m_mutex);
+
+    m_out.write(data, size);
+    if (!m_out.good())
+        return false;
+
+    m_entries.push_back({ std::string(path), m_offset, size, raw_size, codec });
+    m_offset += size;
+    return true;
+}
+
+void BundleWriter::alias(std::string_view path, std::string_view target)
+{
+    std::lock_guard lock(m_mutex);
+    m_aliases.emplace_back(path, target);
+}
+
+// stable so that the last page written for a path wins
+std::vector<BundleWriter::PendingEntry> BundleWriter::sorted_unique(std::vector<PendingEntry> &pending_entries)
+{
+    std::stable_sort(pending_entries.begin(), pending_entries.end(),
+            [](const PendingEntry &a, const PendingEntry &b) { return a.path < b.path; });
+
+    std::vector<PendingEntry> entries;
+    entries.reserve(pending_entries.size());
+    for (auto &pending : pending_entries) {
+        if (!entries.empty() && entries.back().path == pending.path)
+            entries.back() = std::move(pending);
+        else
+            entries.push_back(std::move(pending));
+    }
+
+    return entries;
+}
+
+bool BundleWriter::close()
+{
+    std::lock_guard lock(m_mutex);
+
+    std::vector<PendingEntry> entries = sorted_unique(m_entries);
+
+    if (!m_aliases.empty()) {
+        size_t target_count = entries.size();
+        for (auto &[path, target] : m_aliases) {
+            auto it = std::lower_bound(entries.begin(), entries.begin() + target_count, target,
+                    [](const PendingEntry &entry, const std::string &p) { return entry.path < p; });
+            if (it == entries.begin() + target_count || it->path != target)
+                return false;
+
+            PendingEntry aliased = *it;
+            aliased.path = path;
+            entries.push_back(std::move(aliased));
+        }
+        entries = sorted_unique(entries);
+    }
+
+    BundleTrailer trailer {};
+    trailer.strings_offset = m_offset;
+
+    std::vector<BundleEntry> index;
+    index.reserve(entries.size());
+    for (auto &pending : entries) {
+        BundleEntry entry {};
+        entry.offset = pending.offset;
+        entry.size = pending.size;
+        entry.raw_size = pending.raw_size;
+        entry.path_offset = trailer.strings_size;
+        entry.path_size = pending.path.size();
+        entry.codec = pending.codec;
+        index.push_back(entry);
+
+        m_out.write(pending.path.data(), pending.path.size());
+        trailer.strings_size += pending.path.size();
+    }
+
+    static const char padding[8] = {};
+    size_t pad = (8 - (m_offset + trailer.strings_size) % 8) % 8;
+    m_out.write(padding, pad);
+
+    trailer.entries_offset = m_offset + trailer.strings_size + pad;
+    trailer.entry_count = index.size();
+    std::memcpy(trailer.magic, BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC));
+
+    m_out.write((const char *)index.data(), index.size() * sizeof(BundleEntry));
+    m_out.write((const char *)&trailer, sizeof(trailer));
+    m_out.close();
+
+    m_entries.clear();
+    return !m_out.fail();
+}
+
+BundleReader::BundleReader(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(BUNDLE_MAGIC) + sizeof(BundleTrailer)) {
+        ::close(fd);
+        return;
+    }
+
+    void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+        return;
+
+    m_data = (const char *)mapping;
+    m_size = st.st_size;
+
+    if (!validate()) {
+        munmap(mapping, m_size);
+        m_data = nullptr;
+        m_size = 0;
+        m_entries = nullptr;
+        m_strings = nullptr;
+        m_entry_count = 0;
+    }
+}
+
+// Checks the trailer and every entry against the file once, so that
+// path(), body() and extract() can trust them. All sums are compared as
+// differences, so corrupt values cannot overflow past the checks.
+bool BundleReader::validate()
+{
+    uint64_t index_end = m_size - sizeof(BundleTrailer);
+    const BundleTrailer *trailer = (const BundleTrailer *)(m_data + index_end);
+    if (std::memcmp(m_data, BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC)) != 0 ||
+            std::memcmp(trailer->magic, BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC)) != 0)
+        return false;
+
+    if (trailer->entries_offset > index_end || trailer->entries_offset % 8 != 0 ||
+            trailer->entry_count != (index_end - trailer->entries_offset) / sizeof(BundleEntry) ||
+            (index_end - trailer->entries_offset) % sizeof(BundleEntry) != 0)
+        return false;
+    if (trailer->strings_offset < sizeof(BUNDLE_MAGIC) || trailer->strings_offset > trailer->entries_offset ||
+            trailer->strings_size > trailer->entries_offset - trailer->strings_offset)
+        return false;
+
+    m_entries = (const BundleEntry *)(m_data + trailer->entries_offset);
+    m_entry_count = trailer->entry_count;
+    m_strings = m_data + trailer->strings_offset;
+
+    // bodies lie between the magic and the path strings
+    for (size_t i = 0; i < m_entry_count; i++) {
+        const BundleEntry &entry = m_entries[i];
+        if (entry.offset < sizeof(BUNDLE_MAGIC) || entry.offset > trailer->strings_offset ||
+                entry.size > trailer->strings_offset - entry.offset)
+            return false;
+        if (entry.path_offset > trailer->strings_size ||
+                entry.path_size > trailer->strings_size - entry.path_offset)
+            return false;
+        if (entry.raw_size > MAX_RAW_SIZE)
+            return false;
+        // find() binary searches the entries, which needs unique sorted paths
+        if (i > 0 && !(path(m_entries[i - 1]) < path(entry)))
+            return false;
+
+        switch (entry.codec) {
+        case BundleCodec::Raw:
+            if (entry.raw_size != entry.size)
+                return false;
+            break;
+        case BundleCodec::Gzip:
+        case BundleCodec::Zstd:
+            break;
+        default:
+            return false;
+        }
+    }
+
+    return true;
+}
+
+BundleReader::~BundleReader()
+{
+    if (m_data)
+        munmap((void *)m_data, m_size);
+}
+
+bool BundleReader::is_open() const
+{
+    return m_data != nullptr;
+}
+
+size_t BundleReader::size() const
+{
+    return m_entry_count;
+}
+
+const BundleEntry &BundleReader::entry(size_t i) const
+{
+    return m_entries[i];
+}
+
+std::string_view BundleReader::path(const BundleEntry &entry) const
+{
+    return std::string_view(m_strings + entry.path_offset, entry.path_size);
+}
+
+const BundleEntry *BundleReader::find(std::string_view path) const
+{
+    const BundleEntry *end = m_entries + m_entry_count;
+    const BundleEntry *it = std::lower_bound(m_entries, end, path,
+            [this](const BundleEntry &entry, std::string_view p) { return this->path(entry) < p; });
+
+    if (it == end || this->path(*it) != path)
+        return nullptr;
+    return it;
+}
+
+std::string_view BundleReader::body(const BundleEntry &entry) const
+{
+    return std::string_view(m_data + entry.offset, entry.size);
+}
+
+bool BundleReader::extract(const BundleEntry &entry, std::string &out) const
+{
+    std::string_view stored = body(entry);
+
+    switch (entry.codec) {
+    case BundleCodec::Raw:
+        out.assign(stored);
+        return true;
+    case BundleCodec::Gzip:
+        return gzip_decompress(stored.data(), stored.size(), entry.raw_size, out);
+#ifdef ZSTD
+    case BundleCodec::Zstd:
+        return zstd_decompress(stored.data(), stored.size(), entry.raw_size, out);
+#endif
+    default:
+        return false;
+    }
+}
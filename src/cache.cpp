@@ -0,0 +1,141 @@
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <unistd.h>
+#include "cache.h"
+
+namespace fs = std::filesystem;
+
+HighlightCache::HighlightCache(const std::string &dir, size_t max_bytes)
+    : m_dir(dir),
+      m_max_bytes(max_bytes)
+{
+}
+
+fs::path HighlightCache::entry_path(std::string_view key) const
+{
+    return m_dir / key.substr(0, 2) / key;
+}
+
+bool HighlightCache::load(std::string_view key, std::string &out)
+{
+    fs::path path = entry_path(key);
+    std::ifstream in_stream(path, std::ios::in | std::ios::binary);
+    if (!in_stream.is_open()) {
+        m_stats.misses++;
+        return false;
+    }
+
+    std::error_code ec;
+    uintmax_t size = fs::file_size(path, ec);
+    if (ec) {
+        m_stats.misses++;
+        return false;
+    }
+
+    out.resize(size);
+    in_stream.read(out.data(), size);
+    if ((uintmax_t)in_stream.gcount() != size) {
+        m_stats.misses++;
+        return false;
+    }
+
+    // the access time for eviction; a failure only makes the entry look older
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    m_stats.hits++;
+    return true;
+}
+
+bool HighlightCache::store(std::string_view key, std::string_view content)
+{
+    fs::path path = entry_path(key);
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+    if (ec)
+        return false;
+
+    // unique per process, so concurrent runs never write the same temp file
+    fs::path tmp_path = path;
+    tmp_path += ".tmp" + std::to_string(getpid());
+
+    {
+        std::ofstream out_stream(tmp_path, std::ios::out | std::ios::binary);
+        if (!out_stream.is_open())
+            return false;
+        out_stream.write(content.data(), content.size());
+        if (!out_stream.good()) {
+            out_stream.close();
+            fs::remove(tmp_path, ec);
+            return false;
+        }
+    }
+
+    fs::rename(tmp_path, path, ec);
+    if (ec) {
+        fs::remove(tmp_path, ec);
+        return false;
+    }
+
+    m_stats.stored++;
+    return true;
+}
+
+// Whether a file found in the cache directory is an entry: named by its key
+// under the directory of the key's first two characters, and not a
+// temporary file of a store() in progress.
+static bool is_entry(const fs::path &path)
+{
+    std::string name = path.filename().string();
+    if (name.size() < 2 || name.compare(0, 2, path.parent_path().filename().string()) != 0)
+        return false;
+
+    size_t tmp_pos = name.rfind(".tmp");
+    if (tmp_pos == std::string::npos || tmp_pos + 4 == name.size())
+        return true;
+    return !std::all_of(name.begin() + tmp_pos + 4, name.end(), [](char c) { return c >= '0' && c <= '9'; });
+}
+
+void HighlightCache::trim()
+{
+    struct Entry {
+        fs::file_time_type time;
+        uintmax_t size;
+        fs::path path;
+    };
+
+    std::vector<Entry> entries;
+    uintmax_t total = 0;
+
+    std::error_code ec;
+    for (fs::recursive_directory_iterator it(m_dir, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it.depth() != 1 || !it->is_regular_file(ec) || !is_entry(it->path()))
+            continue;
+        uintmax_t size = it->file_size(ec);
+        fs::file_time_type time = it->last_write_time(ec);
+        if (ec)
+            continue;
+        entries.push_back({ time, size, it->path() });
+        total += size;
+    }
+
+    if (total <= m_max_bytes)
+        return;
+
+    std::sort(entries.begin(), entries.end(),
+        [](const Entry &a, const Entry &b) { return a.time < b.time; });
+
+    for (auto &entry : entries) {
+        if (total <= m_max_bytes)
+            break;
+        // an entry that cannot be removed still takes its space
+        if (fs::remove(entry.path, ec)) {
+            m_stats.evicted++;
+            total -= entry.size;
+        }
+    }
+}
+
+const HighlightCache::Stats &HighlightCache::stats() const
+{
+    return m_stats;
+}
@@ -0,0 +1,162 @@
+#include <array>
+#include <charconv>
+#include "classify.h"
+#include "lines.h"
+
+// bytes of a file looked at for its line lengths
+static const size_t SAMPLE_BYTES = 0x10000;
+
+// a file with a line this long and this long an average is minified; long
+// paragraphs of prose stay well under either
+static const size_t MINIFIED_LONGEST_LINE = 2048;
+static const size_t MINIFIED_AVERAGE_LINE = 200;
+
+static const std::string_view LFS_VERSION_LINE = "version https://git-lfs.github.com/spec/v1\n";
+
+static const std::array<std::string_view, 9> VENDORED_DIRS = {
+    "vendor", "vendors", "node_modules", "bower_components", "third_party",
+    "third-party", "thirdparty", "3rdparty", "Godeps",
+};
+
+static const std::array<std::string_view, 9> GENERATED_FILES = {
+    "package-lock.json", "yarn.lock", "pnpm-lock.yaml", "Cargo.lock", "go.sum",
+    "poetry.lock", "composer.lock", "Gemfile.lock", "flake.lock",
+};
+
+static const std::array<std::string_view, 6> GENERATED_SUFFIXES = {
+    ".pb.go", ".pb.cc", ".pb.h", "_pb2.py", ".designer.cs", ".generated.go",
+};
+
+static const std::array<std::string_view, 4> MINIFIED_SUFFIXES = {
+    ".min.js", ".min.css", ".min.mjs", "-min.js",
+};
+
+const char *content_class_name(ContentClass content_class)
+{
+    switch (content_class) {
+    case ContentClass::Vendored:
+        return "vendored";
+    case ContentClass::Generated:
+        return "generated";
+    case ContentClass::Minified:
+        return "minified";
+    case ContentClass::LfsPointer:
+        return "Git LFS pointer";
+    default:
+        return "";
+    }
+}
+
+bool LineStats::minified() const
+{
+    return m_lines && m_longest >= MINIFIED_LONGEST_LINE && m_bytes / m_lines >= MINIFIED_AVERAGE_LINE;
+}
+
+bool is_lfs_pointer(std::string_view content)
+{
+    return content.size() < LFS_POINTER_MAX_SIZE && content.starts_with(LFS_VERSION_LINE);
+}
+
+bool parse_lfs_pointer(std::string_view content, LfsPointer &pointer)
+{
+    if (!is_lfs_pointer(content))
+        return false;
+
+    bool has_oid = false, has_size = false;
+    LineReader lines(content.data(), content.size());
+    std::string_view line;
+    while (lines.next(line)) {
+        if (line.starts_with("oid ")) {
+            pointer.oid = line.substr(4);
+            has_oid = true;
+        } else if (line.starts_with("size ")) {
+            auto result = std::from_chars(line.data() + 5, line.data() + line.size(), pointer.size);
+            has_size = result.ec == std::errc();
+        }
+    }
+    return has_oid && has_size;
+}
+
+// -1 unset, 1 set, 0 unspecified
+static int attr_state(git_repository *repo, const char *path, const char *name)
+{
+    uint32_t flags = GIT_ATTR_CHECK_FILE_THEN_INDEX;
+#ifdef GIT_ATTR_CHECK_INCLUDE_HEAD
+    // bare repositories only have the attributes committed at HEAD
+    flags |= GIT_ATTR_CHECK_INCLUDE_HEAD;
+#endif
+
+    const char *value;
+    if (git_attr_get(&value, repo, flags, path, name) < 0)
+        return 0;
+
+    switch (git_attr_value(value)) {
+    case GIT_ATTR_VALUE_TRUE:
+        return 1;
+    case GIT_ATTR_VALUE_FALSE:
+        return -1;
+    case GIT_ATTR_VALUE_STRING:
+        return std::string_view(value) == "false" ? -1 : 1;
+    default:
+        return 0;
+    }
+}
+
+template <size_t N>
+static bool ends_with_any(std::string_view name, const std::array<std::string_view, N> &suffixes)
+{
+    for (auto suffix : suffixes)
+        if (name.ends_with(suffix))
+            return true;
+    return false;
+}
+
+std::optional<ContentClass> classify_path(git_repository *repo, const char *path)
+{
+    int generated = attr_state(repo, path, "linguist-generated");
+    if (generated > 0)
+        return ContentClass::Generated;
+    int vendored = attr_state(repo, path, "linguist-vendored");
+    if (vendored > 0)
+        return ContentClass::Vendored;
+    if (generated < 0 || vendored < 0)
+        return ContentClass::Normal;
+
+    std::string_view rest = path;
+    while (true) {
+        size_t slash = rest.find('/');
+        if (slash == std::string_view::npos)
+            break;
+        std::string_view dir = rest.substr(0, slash);
+        for (auto vendored_dir : VENDORED_DIRS)
+            if (dir == vendored_dir)
+                return ContentClass::Vendored;
+        rest = rest.substr(slash + 1);
+    }
+
+    for (auto name : GENERATED_FILES)
+        if (rest == name)
+            return ContentClass::Generated;
+    if (ends_with_any(rest, GENERATED_SUFFIXES))
+        return ContentClass::Generated;
+    if (ends_with_any(rest, MINIFIED_SUFFIXES))
+        return ContentClass::Minified;
+
+    return std::nullopt;
+}
+
+ContentClass classify_file(git_repository *repo, const char *path, std::string_view content)
+{
+    if (is_lfs_pointer(content))
+        return ContentClass::LfsPointer;
+
+    if (auto content_class = classify_path(repo, path))
+        return *content_class;
+
+    LineStats stats;
+    LineReader lines(content.data(), std::min(content.size(), SAMPLE_BYTES));
+    std::string_view line;
+    while (lines.next(line))
+        stats.add(line);
+    return stats.minified() ? ContentClass::Minified : ContentClass::Normal;
+}
@@ -1,20 +1,155 @@
-#include <srchilite/sourcehighlight.h>
+#include <memory>
+#include <utility>
+#include <unordered_map>
 #include <srchilite/langmap.h>
+#include <srchilite/formatter.h>
+#include <srchilite/formatterparams.h>
+#include <srchilite/formattermanager.h>
+#include <srchilite/langdefmanager.h>
+#include <srchilite/regexrulefactory.h>
+#include <srchilite/sourcehighlighter.h>
 #include "color.h"
+#include "escape.h"
 
 #define SRCHILI_DIR "/usr/share/source-highlight"
 
-void highlight(const std::string &filename, std::istream &in, std::ostream &out)
+// source-highlight elements and the classes of the built-in highlighter's
+// tokens they are shown as; anything else is plain text
+static const std::pair<const char *, const char *> ELEMENT_CLASSES[] = {
+    { "keyword", "kw" },
+    { "type", "ty" },
+    { "classname", "ty" },
+    { "string", "st" },
+    { "regexp", "st" },
+    { "specialchar", "st" },
+    { "comment", "cm" },
+    { "todo", "cm" },
+    { "number", "nu" },
+    { "preproc", "pp" },
+    { "function", "fn" },
+    { "variable", "va" },
+};
+
+// Appends the text of an element to the line being highlighted, escaped
+// and wrapped in its class, if any.
+class SpanFormatter : public srchilite::Formatter {
+public:
+    SpanFormatter(std::string *const &out, const char *css_class)
+        : m_out(out),
+          m_class(css_class)
+    {
+    }
+
+    void format(const std::string &s, const srchilite::FormatterParams *) override
+    {
+        if (s.empty())
+            return;
+
+        std::string &out = *m_out;
+        if (m_class) {
+            out += "<span class=\"";
+            out += m_class;
+            out += "\">";
+        }
+        escape_html(out, s);
+        if (m_class)
+            out += "</span>";
+    }
+
+private:
+    std::string *const &m_out;
+    const char *m_class;
+};
+
+// Parsing lang.map and the language definitions are the expensive parts of
+// source-highlight, so each thread keeps them for good. The formatters
+// write wherever out points, which is the line being highlighted.
+struct ColorThread {
+    ColorThread()
+        : lang_map(SRCHILI_DIR, "lang.map"),
+          lang_defs(&rule_factory),
+          formatters(srchilite::FormatterPtr(new SpanFormatter(out, nullptr)))
+    {
+        lang_map.open();
+        for (auto &[element, css_class] : ELEMENT_CLASSES)
+            formatters.addFormatter(element, srchilite::FormatterPtr(new SpanFormatter(out, css_class)));
+    }
+
+    std::string *out { nullptr };
+    srchilite::LangMap lang_map;
+    srchilite::RegexRuleFactory rule_factory;
+    srchilite::LangDefManager lang_defs;
+    srchilite::FormatterManager formatters;
+
+    // by language definition file, null for the ones that failed to parse
+    std::unordered_map<std::string, srchilite::HighlightStatePtr> states;
+};
+
+static ColorThread &color_thread()
+{
+    // created on first use, so threads that never highlight pay nothing
+    static thread_local std::unique_ptr<ColorThread> thread;
+    if (!thread)
+        thread = std::make_unique<ColorThread>();
+    return *thread;
+}
+
+struct ColorState {
+    ColorState(const std::string &lang, srchilite::HighlightStatePtr main_state)
+        : lang(lang),
+          highlighter(main_state)
+    {
+        highlighter.setFormatterManager(&color_thread().formatters);
+        highlighter.setFormatterParams(&params);
+    }
+
+    std::string lang;
+    srchilite::FormatterParams params;
+    srchilite::SourceHighlighter highlighter;
+};
+
+std::unique_ptr<ColorHighlighter> ColorHighlighter::create(const std::string &filename)
+{
+    ColorThread &thread = color_thread();
+
+    std::string lang = thread.lang_map.getMappedFileNameFromFileName(filename);
+    if (lang.empty())
+        return nullptr;
+
+    auto state = thread.states.find(lang);
+    if (state == thread.states.end()) {
+        srchilite::HighlightStatePtr main_state;
+        try {
+            main_state = thread.lang_defs.getHighlightState(SRCHILI_DIR, lang);
+        } catch (...) {
+            // a broken definition leaves the language unhighlighted
+        }
+        state = thread.states.emplace(lang, main_state).first;
+    }
+    if (!state->second)
+        return nullptr;
+
+    return std::unique_ptr<ColorHighlighter>(
+        new ColorHighlighter(std::make_unique<ColorState>(lang, state->second)));
+}
+
+ColorHighlighter::ColorHighlighter(std::unique_ptr<ColorState> state)
+    : m_state(std::move(state))
 {
-    srchilite::SourceHighlight src_hili("html_gitgen.outlang");
-    src_hili.setCanUseStdOut(false);
-    src_hili.setTabSpaces(4);
-    src_hili.setDataDir(SRCHILI_DIR);
+}
+
+ColorHighlighter::~ColorHighlighter() = default;
 
-    srchilite::LangMap lang_map(SRCHILI_DIR, "lang.map");
-    std::string lang = lang_map.getMappedFileNameFromFileName(filename);
-    if (lang == "")
-        lang = "nohilite.lang";
+const std::string &ColorHighlighter::lang() const
+{
+    return m_state->lang;
+}
 
-    src_hili.highlight(in, out, lang);
+void ColorHighlighter::highlight_line(std::string &out, std::string_view line)
+{
+    ColorThread &thread = color_thread();
+    thread.out = &out;
+    m_state->params.start = 0;
+    m_state->highlighter.highlightParagraph(std::string(line));
+    thread.out = nullptr;
 }
@@ -0,0 +1,69 @@
+#include <limits>
+#include <fmt/format.h>
+#include "date.h"
+
+static const int64_t SECONDS_PER_DAY = 86400;
+
+// year, month and day of a day count since 1970-01-01 in the proleptic
+// Gregorian calendar (see http://howardhinnant.github.io/date_algorithms.html)
+static void civil_from_days(int64_t days, int64_t &year, unsigned &month, unsigned &day)
+{
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned doe = (unsigned)(days - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+
+    day = doy - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = (int64_t)yoe + era * 400 + (month <= 2);
+}
+
+DateFormatter::DateFormatter(bool utc)
+    : m_utc(utc),
+      m_cached_day(std::numeric_limits<int64_t>::min())
+{
+}
+
+void DateFormatter::format(std::string &out, int64_t time, int offset) const
+{
+    if (!m_utc)
+        time += (int64_t)offset * 60;
+
+    int64_t days = time / SECONDS_PER_DAY;
+    int64_t seconds = time % SECONDS_PER_DAY;
+    if (seconds < 0) {
+        days--;
+        seconds += SECONDS_PER_DAY;
+    }
+
+    if (days != m_cached_day) {
+        int64_t year;
+        unsigned month, day;
+        civil_from_days(days, year, month, day);
+
+        auto result = fmt::format_to_n(m_day_prefix, sizeof(m_day_prefix), "{:04}-{:02}-{:02}", year, month, day);
+        m_day_prefix_size = result.size;
+        m_cached_day = days;
+    }
+
+    unsigned hour = seconds / 3600;
+    unsigned minute = seconds / 60 % 60;
+    char clock[6] = {
+        ' ',
+        (char)('0' + hour / 10), (char)('0' + hour % 10),
+        ':',
+        (char)('0' + minute / 10), (char)('0' + minute % 10),
+    };
+
+    out.append(m_day_prefix, m_day_prefix_size);
+    out.append(clock, sizeof(clock));
+}
+
+std::string DateFormatter::format(int64_t time, int offset) const
+{
+    std::string out;
+    format(out, time, offset);
+    return out;
+}
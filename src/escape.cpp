@@ -0,0 +1,107 @@
+#include "escape.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ESCAPE_X86
+#endif
+
+struct EntityTable {
+    constexpr EntityTable()
+    {
+        entities[(unsigned char)'&'] = "&amp;";
+        entities[(unsigned char)'<'] = "&lt;";
+        entities[(unsigned char)'>'] = "&gt;";
+        entities[(unsigned char)'"'] = "&quot;";
+        entities[(unsigned char)'\''] = "&#39;";
+    }
+
+    const char *entities[256] {};
+};
+
+static constexpr EntityTable ENTITIES;
+
+static const char *find_special_scalar(const char *p, const char *end)
+{
+    while (p < end && !ENTITIES.entities[(unsigned char)*p])
+        p++;
+    return p;
+}
+
+#ifdef ESCAPE_X86
+__attribute__((target("sse2")))
+static const char *find_special_sse2(const char *p, const char *end)
+{
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i quot = _mm_set1_epi8('"');
+    const __m128i apos = _mm_set1_epi8('\'');
+
+    for (; end - p >= 16; p += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+        __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, amp), _mm_cmpeq_epi8(chunk, lt)),
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, gt), _mm_cmpeq_epi8(chunk, quot)),
+                _mm_cmpeq_epi8(chunk, apos)));
+        unsigned mask = _mm_movemask_epi8(hits);
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+
+    return find_special_scalar(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char *find_special_avx2(const char *p, const char *end)
+{
+    const __m256i amp = _mm256_set1_epi8('&');
+    const __m256i lt = _mm256_set1_epi8('<');
+    const __m256i gt = _mm256_set1_epi8('>');
+    const __m256i quot = _mm256_set1_epi8('"');
+    const __m256i apos = _mm256_set1_epi8('\'');
+
+    for (; end - p >= 32; p += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)p);
+        __m256i hits = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, amp), _mm256_cmpeq_epi8(chunk, lt)),
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, gt), _mm256_cmpeq_epi8(chunk, quot)),
+                _mm256_cmpeq_epi8(chunk, apos)));
+        unsigned mask = _mm256_movemask_epi8(hits);
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+
+    return find_special_sse2(p, end);
+}
+#endif
+
+using find_special_fn = const char *(*)(const char *, const char *);
+
+static find_special_fn pick_find_special()
+{
+#ifdef ESCAPE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return find_special_avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return find_special_sse2;
+#endif
+    return find_special_scalar;
+}
+
+static const find_special_fn find_special = pick_find_special();
+
+void escape_html(std::string &out, const char *str, size_t len)
+{
+    const char *end = str + len;
+
+    while (str < end) {
+        const char *special = find_special(str, end);
+        out.append(str, special - str);
+        if (special == end)
+            break;
+
+        out.append(ENTITIES.entities[(unsigned char)*special]);
+        str = special + 1;
+    }
+}
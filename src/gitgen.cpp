@@ -3,13 +3,21 @@
 #include <fmt/format.h>
 #include "repo.h"
 #include "index.h"
+#include "bundle.h"
+#include "templates.h"
 
 namespace fs = std::filesystem;
 
 static void usage(char *name)
 {
-    fmt::print(stderr, "usage: {} repo <path> [--max-commits <max>] [--max-filesize <max>] [--max-diff-lines <max>]\n", name);
-    fmt::print(stderr, "       {} index <repo path>...\n", name);
+    fmt::print(stderr, "usage: {} repo <path> [--max-commits <max>] [--max-filesize <max>] [--chunk-lines <lines>] [--max-chunked-filesize <max>] [--max-diff-lines <max>] [--raw] [--compact] [--split-diffs] [--classify] [--stats] [output options]\n", name);
+    fmt::print(stderr, "           [--highlight] [--highlight-budget <ms>] [--highlight-cache <dir>] [--highlight-cache-size <size>]\n");
+    fmt::print(stderr, "       {} index <repo path>... [output options]\n", name);
+    fmt::print(stderr, "       {} bundle <bundle path> [<page path>]\n", name);
+    fmt::print(stderr, "output options: [--gzip] [--gzip-level <level>] [--zstd] [--zstd-level <level>]\n");
+    fmt::print(stderr, "                [--compress-min-size <size>] [--jobs <count>] [--bundle <bundle path>]\n");
+    fmt::print(stderr, "                [--manifest <manifest path>] [--symlinks] [--max-output-bytes <max>]\n");
+    fmt::print(stderr, "                [--minify] [--template-dir <dir>] [--utc]\n");
     exit(1);
 }
 
@@ -19,16 +27,56 @@ struct Args {
     enum class CmdType {
         None,
         Repo,
-        Index
+        Index,
+        Bundle
     } cmd_type { CmdType::None };
 
     RepoHtmlGen::Options repo_options;
     IndexHtmlGen::Options index_options;
+    OutputWriter::Options output_options;
+
+    std::string bundle_path;
+    std::string bundle_page;
+    std::string template_dir;
+    bool utc { false };
 
     bool touched_repo_options { false };
     bool touched_index_options { false };
 };
 
+// lists the pages of a bundle, or writes one page to stdout
+static int read_bundle(const std::string &bundle_path, const std::string &page)
+{
+    BundleReader reader(bundle_path);
+    if (!reader.is_open()) {
+        fmt::print(stderr, "Error occurred: failed to open bundle {}\n", bundle_path);
+        return 1;
+    }
+
+    if (page.empty()) {
+        for (size_t i = 0; i < reader.size(); i++) {
+            const BundleEntry &entry = reader.entry(i);
+            fmt::print("{}\t{}\t{}\n", reader.path(entry), entry.raw_size, entry.size);
+        }
+        return 0;
+    }
+
+    const BundleEntry *entry = reader.find(page);
+    if (!entry) {
+        fmt::print(stderr, "Error occurred: no page {} in bundle\n", page);
+        return 1;
+    }
+
+    std::string content;
+    if (!reader.extract(*entry, content)) {
+        fmt::print(stderr, "Error occurred: failed to extract {}\n", page);
+        return 1;
+    }
+
+    fwrite(content.data(), 1, content.size(), stdout);
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
     if (argc == 1)
@@ -36,12 +84,17 @@ int main(int argc, char **argv)
 
     Args args(argc, argv);
 
+    if (!args.template_dir.empty() && !load_templates(args.template_dir))
+        return 1;
+
     if (args.cmd_type == Args::CmdType::Repo) {
         RepoHtmlGen gen(args.repo_options);
         gen.generate();
     } else if (args.cmd_type == Args::CmdType::Index) {
         IndexHtmlGen gen(args.index_options);
         gen.generate();
+    } else if (args.cmd_type == Args::CmdType::Bundle) {
+        return read_bundle(args.bundle_path, args.bundle_page);
     }
 
     return 0;
@@ -64,12 +117,33 @@ Args::Args(size_t argc, char **argv)
         } else if (arg == "index") {
             cmd_type = CmdType::Index;
             touched_index_options = true;
+        } else if (arg == "bundle") {
+            if (++i >= argc)
+                usage(argv[0]);
+            bundle_path = argv[i];
+            if (i + 1 < argc)
+                bundle_page = argv[++i];
+            if (i + 1 < argc)
+                usage(argv[0]);
+            cmd_type = CmdType::Bundle;
         } else if (arg == "--max-commits") {
             if (++i >= argc)
                 usage(argv[0]);
             const std::string arg1(argv[i]);
             repo_options.max_commits = std::stoi(arg1);
             touched_repo_options = true;
+        } else if (arg == "--chunk-lines") {
+            if (++i >= argc)
+                usage(argv[0]);
+            const std::string arg1(argv[i]);
+            repo_options.view_chunk_lines = std::stoull(arg1);
+            touched_repo_options = true;
+        } else if (arg == "--max-chunked-filesize") {
+            if (++i >= argc)
+                usage(argv[0]);
+            const std::string arg1(argv[i]);
+            repo_options.max_chunked_filesize = std::stoull(arg1);
+            touched_repo_options = true;
         } else if (arg == "--max-filesize") {
             if (++i >= argc)
                 usage(argv[0]);
@@ -82,6 +156,95 @@ Args::Args(size_t argc, char **argv)
             const std::string arg1(argv[i]);
             repo_options.max_diff_lines = std::stoi(arg1);
             touched_repo_options = true;
+        } else if (arg == "--raw") {
+            repo_options.raw = true;
+            touched_repo_options = true;
+        } else if (arg == "--max-output-bytes") {
+            if (++i >= argc)
+                usage(argv[0]);
+            const std::string arg1(argv[i]);
+            output_options.max_bytes = std::stoull(arg1);
+        } else if (arg == "--symlinks") {
+            output_options.symlinks = true;
+        } else if (arg == "--compact") {
+            repo_options.compact = true;
+            touched_repo_options = true;
+        } else if (arg == "--classify") {
+            repo_options.classify = true;
+            touched_repo_options = true;
+        } else if (arg == "--split-diffs") {
+            repo_options.split_diffs = true;
+            touched_repo_options = true;
+        } else if (arg == "--highlight") {
+            repo_options.highlight = true;
+            touched_repo_options = true;
+        } else if (arg == "--highlight-cache") {
+            if (++i >= argc)
+                usage(argv[0]);
+            repo_options.highlight_cache = argv[i];
+            touched_repo_options = true;
+        } else if (arg == "--highlight-budget") {
+            if (++i >= argc)
+                usage(argv[0]);
+            const std::string arg1(argv[i]);
+            repo_options.highlight_budget_ms = std::stoull(arg1);
+            touched_repo_options = true;
+        } else if (arg == "--highlight-cache-size") {
+            if (++i >= argc)
+                usage(argv[0]);
+            const std::string arg1(argv[i]);
+            repo_options.highlight_cache_max_bytes = std::stoull(arg1);
+            touched_repo_options = true;
+        } else if (arg == "--stats") {
+            repo_options.stats = true;
+            touched_repo_options = true;
+        } else if (arg == "--gzip") {
+            output_options.gzip = true;
+        } else if (arg == "--gzip-level") {
+            if (++i >= argc)
+                usage(argv[0]);
+            const std::string arg1(argv[i]);
+            output_options.gzip = true;
+            output_options.gzip_level = std::stoi(arg1);
+        } else if (arg == "--zstd" || arg == "--zstd-level") {
+#ifdef ZSTD
+            output_options.zstd = true;
+            if (arg == "--zstd-level") {
+                if (++i >= argc)
+                    usage(argv[0]);
+                const std::string arg1(argv[i]);
+                output_options.zstd_level = std::stoi(arg1);
+            }
+#else
+            fmt::print(stderr, "{} was built without zstd support (GG_ZSTD=TRUE)\n", argv[0]);
+            exit(1);
+#endif
+        } else if (arg == "--compress-min-size") {
+            if (++i >= argc)
+                usage(argv[0]);
+            const std::string arg1(argv[i]);
+            output_options.compress_min_size = std::stoul(arg1);
+        } else if (arg == "--jobs") {
+            if (++i >= argc)
+                usage(argv[0]);
+            const std::string arg1(argv[i]);
+            output_options.jobs = std::stoul(arg1);
+        } else if (arg == "--bundle") {
+            if (++i >= argc)
+                usage(argv[0]);
+            output_options.bundle_path = argv[i];
+        } else if (arg == "--manifest") {
+            if (++i >= argc)
+                usage(argv[0]);
+            output_options.manifest_path = argv[i];
+        } else if (arg == "--minify") {
+            output_options.minify = true;
+        } else if (arg == "--utc") {
+            utc = true;
+        } else if (arg == "--template-dir") {
+            if (++i >= argc)
+                usage(argv[0]);
+            template_dir = argv[i];
         } else if (cmd_type == CmdType::Index) {
             index_options.repo_paths.push_back(argv[i]);
         } else {
@@ -98,4 +261,9 @@ Args::Args(size_t argc, char **argv)
         usage(argv[0]);
     if (cmd_type == CmdType::Index && index_options.repo_paths.size() == 0)
         usage(argv[0]);
+
+    repo_options.output = output_options;
+    index_options.output = output_options;
+    repo_options.utc = utc;
+    index_options.utc = utc;
 }
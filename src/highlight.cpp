@@ -0,0 +1,720 @@
+#include <array>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <unordered_set>
+#include "highlight.h"
+#include "escape.h"
+
+enum class Token : uint8_t {
+    Keyword,
+    Type,
+    String,
+    Comment,
+    Number,
+    Preproc,
+    Function,
+    Variable,
+    Key,
+    Plain,
+};
+
+// CSS classes of the tokens but Plain, styled in public/css/style.css
+static const char *TOKEN_CLASSES[] = { "kw", "ty", "st", "cm", "nu", "pp", "fn", "va", "ke" };
+
+enum LanguageFlags : uint32_t {
+    TRIPLE_QUOTES = 1 << 0,     // """ and ''' strings, which may span lines
+    PREPROC = 1 << 1,           // # directives at the start of a line
+    ATTRIBUTES = 1 << 2,        // #[...] and #![...]
+    DECORATORS = 1 << 3,        // @name
+    VARIABLES = 1 << 4,         // $name, ${...} and $@ style specials
+    PAREN_VARIABLES = 1 << 5,   // $(...)
+    FUNCTIONS = 1 << 6,         // a name followed by '(' is a function
+    MACROS = 1 << 7,            // a name followed by '!' is a macro call
+    LINE_KEYS = 1 << 8,         // "name:" at the start of a line is a key
+    STRING_KEYS = 1 << 9,       // a string followed by ':' is a key
+    WORD_COMMENTS = 1 << 10,    // line comments only start a word
+    LIFETIMES = 1 << 11,        // 'a is a lifetime unless it is a char literal
+    DOLLAR_NAMES = 1 << 12,     // '$' is part of names
+    WORD_QUOTES = 1 << 13,      // quotes only start a string at the start of a value
+    PAREN_RAW_STRINGS = 1 << 14,    // R"delim(...)delim", which may span lines
+    HASH_RAW_STRINGS = 1 << 15,     // r"..." and r#"..."#, which may span lines
+    REGEX_LITERALS = 1 << 16,       // /.../flags where an operand is expected
+};
+
+// Everything that tells one language apart from another. Keywords and types
+// are space separated.
+struct LanguageDef {
+    const char *name;
+    const char *keywords;
+    const char *types;
+    std::string_view line_comment;
+    std::string_view block_open;
+    std::string_view block_close;
+    const char *quotes;             // string delimiters
+    const char *raw_quotes;         // delimiters of strings without escapes
+    const char *multiline_quotes;   // delimiters of strings that may span lines
+    const char *string_prefixes;    // letters that may prefix a string, as in r""
+    const char *name_chars;         // extra characters allowed in names after the first
+    uint32_t flags;
+};
+
+static const LanguageDef LANGUAGE_DEFS[] = {
+    {
+        "c",
+        "alignas alignof auto break case catch class co_await co_return co_yield concept const "
+        "const_cast consteval constexpr constinit continue decltype default delete do "
+        "dynamic_cast else enum explicit export extern false final for friend goto if inline "
+        "mutable namespace new noexcept nullptr operator override private protected public "
+        "register reinterpret_cast requires return sizeof static static_assert static_cast "
+        "struct switch template this throw true try typedef typeid typename union using "
+        "virtual volatile while NULL",
+        "bool char char8_t char16_t char32_t double float int long short signed unsigned void "
+        "wchar_t size_t ssize_t ptrdiff_t intptr_t uintptr_t int8_t int16_t int32_t int64_t "
+        "uint8_t uint16_t uint32_t uint64_t FILE",
+        "//", "/*", "*/", "\"'", "", "", "LuUR8", "", FUNCTIONS | PREPROC | PAREN_RAW_STRINGS,
+    },
+    {
+        "python",
+        "False None True and as assert async await break case class continue def del elif "
+        "else except finally for from global if import in is lambda match nonlocal not or "
+        "pass raise return self try while with yield",
+        "bool bytes dict float int list object set str tuple type",
+        "#", "", "", "\"'", "", "", "rRbBfFuU", "", FUNCTIONS | DECORATORS | TRIPLE_QUOTES,
+    },
+    {
+        "go",
+        "break case chan const continue default defer else fallthrough false for func go goto "
+        "if import interface iota map nil package range return select struct switch true "
+        "type var",
+        "any bool byte complex64 complex128 error float32 float64 int int8 int16 int32 int64 "
+        "rune string uint uint8 uint16 uint32 uint64 uintptr",
+        "//", "/*", "*/", "\"'`", "`", "`", "", "", FUNCTIONS,
+    },
+    {
+        "rust",
+        "as async await break const continue crate dyn else enum extern false fn for if impl "
+        "in let loop match mod move mut pub ref return self Self static struct super trait "
+        "true type unsafe use where while",
+        "bool char str u8 u16 u32 u64 u128 usize i8 i16 i32 i64 i128 isize f32 f64 Box Err "
+        "None Ok Option Result Some String Vec",
+        "//", "/*", "*/", "\"'", "", "\"", "rb", "", FUNCTIONS | MACROS | ATTRIBUTES | LIFETIMES | HASH_RAW_STRINGS,
+    },
+    {
+        "js",
+        "abstract as async await break case catch class const continue debugger declare "
+        "default delete do else enum export extends false finally for from function if "
+        "implements import in instanceof interface keyof let namespace new null of private "
+        "protected public readonly return static super switch this throw true try type "
+        "typeof undefined var void while with yield",
+        "any bigint boolean never number object string symbol unknown Array Map Promise Set",
+        "//", "/*", "*/", "\"'`", "", "`", "", "", FUNCTIONS | DECORATORS | DOLLAR_NAMES | REGEX_LITERALS,
+    },
+    {
+        "shell",
+        "break case continue declare do done elif else esac eval exec exit export fi for "
+        "function if in local readonly return select set shift source then time trap unset "
+        "until while",
+        "",
+        "#", "", "", "\"'", "'", "\"'", "", "", VARIABLES | WORD_COMMENTS,
+    },
+    {
+        "make",
+        "define else endef endif export ifdef ifeq ifndef ifneq include override unexport vpath",
+        "",
+        "#", "", "", "", "", "", "", "-./", VARIABLES | PAREN_VARIABLES | LINE_KEYS,
+    },
+    {
+        "yaml",
+        "false no null off on true yes",
+        "",
+        "#", "", "", "\"'", "'", "", "", "-./", LINE_KEYS | WORD_COMMENTS | WORD_QUOTES,
+    },
+    {
+        "json",
+        "false null true",
+        "",
+        "", "", "", "\"", "", "", "", "", STRING_KEYS,
+    },
+};
+
+// File names and extensions (starting with '.') of each language.
+static const struct {
+    std::string_view name;
+    const char *lang;
+} LANGUAGE_FILES[] = {
+    { ".c", "c" }, { ".h", "c" }, { ".cc", "c" }, { ".cpp", "c" }, { ".cxx", "c" },
+    { ".c++", "c" }, { ".hh", "c" }, { ".hpp", "c" }, { ".hxx", "c" }, { ".h++", "c" },
+    { ".ino", "c" },
+    { ".py", "python" }, { ".pyw", "python" }, { ".pyi", "python" },
+    { ".go", "go" },
+    { ".rs", "rust" },
+    { ".js", "js" }, { ".mjs", "js" }, { ".cjs", "js" }, { ".jsx", "js" },
+    { ".ts", "js" }, { ".mts", "js" }, { ".cts", "js" }, { ".tsx", "js" },
+    { ".sh", "shell" }, { ".bash", "shell" }, { ".zsh", "shell" }, { ".ksh", "shell" },
+    { ".bashrc", "shell" }, { ".bash_profile", "shell" }, { ".profile", "shell" },
+    { ".zshrc", "shell" }, { "PKGBUILD", "shell" },
+    { "Makefile", "make" }, { "makefile", "make" }, { "GNUmakefile", "make" },
+    { ".mk", "make" }, { ".mak", "make" },
+    { ".yml", "yaml" }, { ".yaml", "yaml" },
+    { ".json", "json" },
+};
+
+// Interpreters named on a "#!" line.
+static const struct {
+    std::string_view name;
+    const char *lang;
+} LANGUAGE_INTERPRETERS[] = {
+    { "sh", "shell" }, { "bash", "shell" }, { "dash", "shell" }, { "ksh", "shell" },
+    { "zsh", "shell" }, { "python", "python" }, { "python2", "python" },
+    { "python3", "python" }, { "node", "js" }, { "make", "make" },
+};
+
+// what a byte can start outside of comments and strings
+enum class CharClass : uint8_t {
+    Plain,
+    Name,
+    Digit,
+    Quote,
+    Special,    // comments, directives, variables and the like
+};
+
+struct Language {
+    Language(const LanguageDef &def)
+        : def(def)
+    {
+        for (int c = 0; c < 256; c++) {
+            bool letter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c >= 0x80;
+            bool digit = c >= '0' && c <= '9';
+            classes[c] = letter ? CharClass::Name : digit ? CharClass::Digit : CharClass::Plain;
+            name_chars[c] = letter || digit;
+        }
+        for (const char *c = def.name_chars; *c; c++)
+            name_chars[(unsigned char)*c] = true;
+        for (const char *c = def.quotes; *c; c++)
+            classes[(unsigned char)*c] = CharClass::Quote;
+
+        auto special = [&](char c) { classes[(unsigned char)c] = CharClass::Special; };
+        if (!def.line_comment.empty())
+            special(def.line_comment[0]);
+        if (!def.block_open.empty())
+            special(def.block_open[0]);
+        if (def.flags & (PREPROC | ATTRIBUTES))
+            special('#');
+        if (def.flags & PREPROC)
+            special('<');
+        if (def.flags & DECORATORS)
+            special('@');
+        if (def.flags & VARIABLES)
+            special('$');
+        if (def.flags & DOLLAR_NAMES) {
+            classes['$'] = CharClass::Name;
+            name_chars['$'] = true;
+        }
+
+        add_words(keywords, def.keywords);
+        add_words(types, def.types);
+    }
+
+    static void add_words(std::unordered_set<std::string_view> &set, std::string_view words)
+    {
+        while (!words.empty()) {
+            size_t space = words.find(' ');
+            set.insert(words.substr(0, space));
+            if (space == std::string_view::npos)
+                break;
+            words.remove_prefix(space + 1);
+        }
+    }
+
+    bool has(uint32_t flag) const
+    {
+        return def.flags & flag;
+    }
+
+    const LanguageDef &def;
+    std::array<CharClass, 256> classes;
+    std::array<bool, 256> name_chars;
+    std::unordered_set<std::string_view> keywords;
+    std::unordered_set<std::string_view> types;
+};
+
+static const std::vector<Language> &languages()
+{
+    static const std::vector<Language> languages(std::begin(LANGUAGE_DEFS), std::end(LANGUAGE_DEFS));
+    return languages;
+}
+
+static const Language *language_by_name(std::string_view name)
+{
+    for (auto &lang : languages()) {
+        if (name == lang.def.name)
+            return &lang;
+    }
+    return nullptr;
+}
+
+const Language *find_language(std::string_view filename, std::string_view content)
+{
+    size_t dot = filename.rfind('.');
+    std::string_view ext = dot == std::string_view::npos ? std::string_view() : filename.substr(dot);
+
+    for (auto &file : LANGUAGE_FILES) {
+        if (file.name == filename || file.name == ext)
+            return language_by_name(file.lang);
+    }
+
+    if (content.substr(0, 2) != "#!")
+        return nullptr;
+
+    // "#!/bin/sh" or "#!/usr/bin/env python3"
+    std::string_view shebang = content.substr(2, content.find('\n') - 2);
+    size_t start = shebang.find_first_not_of(' ');
+    if (start == std::string_view::npos)
+        return nullptr;
+    shebang.remove_prefix(start);
+    std::string_view interpreter = shebang.substr(0, shebang.find(' '));
+    interpreter.remove_prefix(interpreter.rfind('/') + 1);
+    if (interpreter == "env") {
+        shebang.remove_prefix(std::min(shebang.size(), shebang.find(' ')));
+        start = shebang.find_first_not_of(' ');
+        if (start == std::string_view::npos)
+            return nullptr;
+        interpreter = shebang.substr(start);
+        interpreter = interpreter.substr(0, interpreter.find(' '));
+    }
+
+    for (auto &known : LANGUAGE_INTERPRETERS) {
+        if (known.name == interpreter)
+            return language_by_name(known.lang);
+    }
+    return nullptr;
+}
+
+const char *language_name(const Language &lang)
+{
+    return lang.def.name;
+}
+
+static void write_piece(std::string &out, Token token, const char *begin, const char *end)
+{
+    if (begin == end)
+        return;
+    if (token == Token::Plain) {
+        escape_html(out, begin, end - begin);
+        return;
+    }
+
+    out += "<span class=\"";
+    out += TOKEN_CLASSES[(size_t)token];
+    out += "\">";
+    escape_html(out, begin, end - begin);
+    out += "</span>";
+}
+
+void Highlighter::write(std::string &out, Token token, const char *begin, const char *end) const
+{
+    if (!m_mark) {
+        write_piece(out, token, begin, end);
+        return;
+    }
+
+    const char *mark_begin = std::clamp(m_line + m_mark->begin, begin, end);
+    const char *mark_end = std::clamp(m_line + m_mark->end, begin, end);
+    write_piece(out, token, begin, mark_begin);
+    if (mark_begin < mark_end) {
+        out += m_mark->open;
+        write_piece(out, token, mark_begin, mark_end);
+        out += m_mark->close;
+    }
+    write_piece(out, token, mark_end, end);
+}
+
+static bool starts_with(const char *p, const char *end, std::string_view prefix)
+{
+    return !prefix.empty() && (size_t)(end - p) >= prefix.size() && !memcmp(p, prefix.data(), prefix.size());
+}
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+// Length of the UTF-8 sequence starting with c.
+static size_t utf8_length(unsigned char c)
+{
+    if (c < 0xc0)
+        return 1;
+    if (c < 0xe0)
+        return 2;
+    if (c < 0xf0)
+        return 3;
+    return 4;
+}
+
+// Finds the end of a string delimited by m_quote whose contents start at p,
+// returning the end of its closing delimiter, or nullptr if the line ends
+// first.
+const char *Highlighter::string_end(const char *p, const char *end) const
+{
+    if (!m_raw_close.empty()) {
+        const char *found = std::search(p, end, m_raw_close.begin(), m_raw_close.end());
+        return found == end ? nullptr : found + m_raw_close.size();
+    }
+
+    bool escapes = !strchr(m_lang.def.raw_quotes, m_quote);
+
+    while (p < end) {
+        char c = *p;
+        if (c == '\\' && escapes) {
+            p += std::min<size_t>(2, end - p);
+            continue;
+        }
+        if (c == m_quote) {
+            if (!m_triple)
+                return p + 1;
+            if (end - p >= 3 && p[1] == m_quote && p[2] == m_quote)
+                return p + 3;
+        }
+        p++;
+    }
+    return nullptr;
+}
+
+// Finishes a comment or string left open by the previous line, returning
+// where code starts again.
+const char *Highlighter::continue_line(std::string &out, const char *p, const char *end)
+{
+    if (m_state == State::Comment) {
+        std::string_view close = m_lang.def.block_close;
+        const char *found = std::search(p, end, close.begin(), close.end());
+        if (found == end) {
+            write(out, Token::Comment, p, end);
+            return end;
+        }
+        write(out, Token::Comment, p, found + close.size());
+        m_state = State::Code;
+        return found + close.size();
+    }
+
+    const char *string_end = this->string_end(p, end);
+    if (!string_end) {
+        write(out, Token::String, p, end);
+        return end;
+    }
+    write(out, Token::String, p, string_end);
+    m_state = State::Code;
+    return string_end;
+}
+
+// Keywords after which a '/' starts a regex literal rather than a division.
+static const std::array<std::string_view, 14> REGEX_KEYWORDS = {
+    "return", "typeof", "case", "do", "else", "in", "of", "new", "delete", "void", "throw",
+    "instanceof", "yield", "await",
+};
+
+// Whether a '/' at p starts a regex literal, going by what comes before it
+// on the line: nothing, an operator, an opening bracket or a keyword.
+static bool regex_allowed(const Language &lang, const char *begin, const char *p)
+{
+    while (p > begin && is_space(p[-1]))
+        p--;
+    if (p == begin)
+        return true;
+
+    char c = p[-1];
+    if (strchr("(,=:[!&|?{};~+-*%<>^", c))
+        return true;
+    if (!lang.name_chars[(unsigned char)c])
+        return false;
+
+    const char *word = p;
+    while (word > begin && lang.name_chars[(unsigned char)word[-1]])
+        word--;
+    return std::find(REGEX_KEYWORDS.begin(), REGEX_KEYWORDS.end(), std::string_view(word, p - word))
+        != REGEX_KEYWORDS.end();
+}
+
+// End of a regex literal whose body starts at p, flags included, or nullptr
+// if the line ends first; a '/' within a [...] class does not end it.
+static const char *regex_end(const Language &lang, const char *p, const char *end)
+{
+    bool in_class = false;
+    while (p < end) {
+        char c = *p++;
+        if (c == '\\') {
+            p += p < end;
+        } else if (c == '[') {
+            in_class = true;
+        } else if (c == ']') {
+            in_class = false;
+        } else if (c == '/' && !in_class) {
+            while (p < end && lang.name_chars[(unsigned char)*p])
+                p++;
+            return p;
+        }
+    }
+    return nullptr;
+}
+
+void Highlighter::highlight_line(std::string &out, std::string_view line, const LineMark *mark)
+{
+    const Language &lang = m_lang;
+    m_line = line.data();
+    m_mark = mark;
+
+    const char *begin = line.data();
+    const char *end = begin + line.size();
+    const char *p = begin;
+
+    if (m_state != State::Code)
+        p = continue_line(out, p, end);
+
+    // where the first token of the line starts, past indentation and, for
+    // YAML style keys, list markers
+    const char *first = p;
+    while (first < end && is_space(*first))
+        first++;
+    if (lang.has(LINE_KEYS)) {
+        while (end - first >= 2 && first[0] == '-' && is_space(first[1])) {
+            first += 2;
+            while (first < end && is_space(*first))
+                first++;
+        }
+    }
+
+    bool include = false;   // after #include, where <...> is a file name
+
+    // plain text is written in runs, when the next token or the line ends
+    const char *text = p;
+    auto token = [&](Token kind, const char *token_begin, const char *token_end) {
+        write(out, Token::Plain, text, token_begin);
+        write(out, kind, token_begin, token_end);
+        text = p = token_end;
+    };
+
+    auto name_end = [&](const char *q) {
+        while (q < end && lang.name_chars[(unsigned char)*q])
+            q++;
+        return q;
+    };
+
+    // a string from start, possibly a prefix, whose delimiter is at quote
+    auto string = [&](const char *start, const char *quote) {
+        m_raw_close.clear();
+        m_quote = *quote;
+        m_triple = lang.has(TRIPLE_QUOTES) && end - quote >= 3 && quote[1] == m_quote && quote[2] == m_quote;
+
+        const char *string_end = this->string_end(quote + (m_triple ? 3 : 1), end);
+        if (!string_end) {
+            if (m_triple || strchr(lang.def.multiline_quotes, m_quote))
+                m_state = State::String;
+            token(Token::String, start, end);
+            return;
+        }
+
+        Token kind = Token::String;
+        if (lang.has(STRING_KEYS)) {
+            const char *q = string_end;
+            while (q < end && is_space(*q))
+                q++;
+            if (q < end && *q == ':')
+                kind = Token::Key;
+        }
+        token(kind, start, string_end);
+    };
+
+    // a raw string whose prefix runs from start to q, returning false when
+    // there is none; its contents are scanned for the closing sequence only
+    auto raw_string = [&](const char *start, const char *q) {
+        std::string_view prefix(start, q - start);
+        const char *body;
+        if (lang.has(PAREN_RAW_STRINGS)) {
+            // a delimiter of up to 16 characters between the quote and '('
+            if (!prefix.ends_with('R') || *q != '"')
+                return false;
+            const char *open = q + 1;
+            while (open < end && open - q <= 16 && !strchr(" ()\\\t\"", *open))
+                open++;
+            if (open == end || *open != '(')
+                return false;
+            m_raw_close = ')';
+            m_raw_close.append(q + 1, open);
+            m_raw_close += '"';
+            body = open + 1;
+        } else if (lang.has(HASH_RAW_STRINGS)) {
+            if (prefix != "r" && prefix != "br")
+                return false;
+            const char *quote = q;
+            while (quote < end && *quote == '#')
+                quote++;
+            if (quote == end || *quote != '"')
+                return false;
+            m_raw_close = '"';
+            m_raw_close.append(q, quote);
+            body = quote + 1;
+        } else {
+            return false;
+        }
+
+        m_quote = '"';
+        m_triple = false;
+        const char *string_end = this->string_end(body, end);
+        if (!string_end)
+            m_state = State::String;
+        token(Token::String, start, string_end ? string_end : end);
+        return true;
+    };
+
+    while (p < end) {
+        char c = *p;
+
+        switch (lang.classes[(unsigned char)c]) {
+        case CharClass::Plain:
+            p++;
+            break;
+
+        case CharClass::Name: {
+            const char *q = name_end(p + 1);
+            std::string_view word(p, q - p);
+            bool prefix = word.find_first_not_of(lang.def.string_prefixes) == std::string_view::npos;
+
+            if (q < end && prefix && word.size() <= 3 && raw_string(p, q)) {
+                // lexed as a whole
+            } else if (q < end && lang.classes[(unsigned char)*q] == CharClass::Quote && word.size() <= 2 && prefix) {
+                string(p, q);
+            } else if (lang.has(LINE_KEYS) && p == first && q < end && *q == ':'
+                    && (q + 1 == end || is_space(q[1]))) {
+                token(Token::Key, p, q);
+            } else if (lang.keywords.count(word)) {
+                token(Token::Keyword, p, q);
+            } else if (lang.types.count(word)) {
+                token(Token::Type, p, q);
+            } else if (lang.has(FUNCTIONS) && q < end && *q == '(') {
+                token(Token::Function, p, q);
+            } else if (lang.has(MACROS) && end - q >= 2 && q[0] == '!' && q[1] != '=') {
+                token(Token::Function, p, q + 1);
+            } else {
+                p = q;
+            }
+            break;
+        }
+
+        case CharClass::Digit: {
+            const char *q = p + 1;
+            bool hex = end - p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X');
+            while (q < end) {
+                char d = *q;
+                if (lang.name_chars[(unsigned char)d] || d == '.')
+                    q++;
+                else if ((d == '+' || d == '-') && !hex && (q[-1] == 'e' || q[-1] == 'E'))
+                    q++;
+                else
+                    break;
+            }
+            token(Token::Number, p, q);
+            break;
+        }
+
+        case CharClass::Quote:
+            if (lang.has(WORD_QUOTES) && p != begin && !is_space(p[-1]) && !strchr("[{,:", p[-1])) {
+                // the apostrophe of it's
+                p++;
+                break;
+            }
+            if (lang.has(LIFETIMES) && c == '\'') {
+                // 'a' and '\n' are chars, 'a alone is a lifetime
+                bool char_literal = false;
+                if (end - p >= 3 && p[1] == '\\') {
+                    char_literal = true;
+                } else if (p + 1 < end) {
+                    size_t len = utf8_length(p[1]);
+                    char_literal = p + 1 + len < end && p[1 + len] == '\'';
+                }
+                if (!char_literal) {
+                    p = name_end(p + 1);
+                    break;
+                }
+            }
+
+            string(p, p);
+            break;
+
+        case CharClass::Special:
+            if (starts_with(p, end, lang.def.block_open)) {
+                std::string_view close = lang.def.block_close;
+                const char *found = std::search(p + lang.def.block_open.size(), end, close.begin(), close.end());
+                if (found == end) {
+                    m_state = State::Comment;
+                    token(Token::Comment, p, end);
+                } else {
+                    token(Token::Comment, p, found + close.size());
+                }
+            } else if (starts_with(p, end, lang.def.line_comment)
+                    && (!lang.has(WORD_COMMENTS) || p == begin || is_space(p[-1]))) {
+                token(Token::Comment, p, end);
+            } else if (c == '#' && lang.has(PREPROC) && p == first) {
+                const char *q = p + 1;
+                while (q < end && is_space(*q))
+                    q++;
+                const char *directive = q;
+                q = name_end(q);
+                include = std::string_view(directive, q - directive) == "include";
+                token(Token::Preproc, p, q);
+            } else if (c == '<' && include) {
+                const char *close = (const char *)memchr(p, '>', end - p);
+                token(Token::String, p, close ? close + 1 : end);
+            } else if (c == '#' && lang.has(ATTRIBUTES) && (starts_with(p, end, "#[") || starts_with(p, end, "#!["))) {
+                // up to the matching ']', or the end of the line
+                const char *q = p + 1;
+                int depth = 0;
+                while (q < end) {
+                    char d = *q++;
+                    if (d == '[')
+                        depth++;
+                    else if (d == ']' && --depth == 0)
+                        break;
+                }
+                token(Token::Preproc, p, q);
+            } else if (c == '@' && lang.has(DECORATORS) && p + 1 < end
+                    && lang.classes[(unsigned char)p[1]] == CharClass::Name) {
+                token(Token::Preproc, p, name_end(p + 1));
+            } else if (c == '$' && lang.has(VARIABLES) && p + 1 < end) {
+                char d = p[1];
+                char open = d == '{' || (d == '(' && lang.has(PAREN_VARIABLES)) ? d : 0;
+                if (open) {
+                    char close = open == '{' ? '}' : ')';
+                    const char *q = p + 2;
+                    int depth = 1;
+                    while (q < end && depth) {
+                        if (*q == open)
+                            depth++;
+                        else if (*q == close)
+                            depth--;
+                        q++;
+                    }
+                    token(Token::Variable, p, q);
+                } else if (lang.name_chars[(unsigned char)d] && d != '-' && d != '.' && d != '/') {
+                    token(Token::Variable, p, name_end(p + 1));
+                } else if (d && strchr("@<^?*#!$-+%", d)) {
+                    token(Token::Variable, p, p + 2);
+                } else {
+                    p++;
+                }
+            } else if (c == '/' && lang.has(REGEX_LITERALS) && regex_allowed(lang, begin, p)) {
+                // a regex cannot span lines, a '/' left open is a division
+                const char *q = regex_end(lang, p + 1, end);
+                if (q)
+                    token(Token::String, p, q);
+                else
+                    p++;
+            } else {
+                p++;
+            }
+            break;
+        }
+    }
+
+    write(out, Token::Plain, text, end);
+    m_mark = nullptr;
+}
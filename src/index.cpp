@@ -21,6 +21,8 @@ void IndexHtmlGen::cleanup()
 void IndexHtmlGen::error(const char *msg)
 {
     fmt::print(stderr, "Error occurred (code: {}): {}\n", m_err, msg);
+    // the compression workers run against m_output, stop them before exiting
+    m_output.abandon();
     cleanup();
     exit(1);
 }
@@ -31,7 +33,9 @@ IndexHtmlGen::~IndexHtmlGen()
 }
 
 IndexHtmlGen::IndexHtmlGen(const Options &opt)
-    : m_options(opt)
+    : m_options(opt),
+      m_output(opt.output),
+      m_dates(opt.utc)
 {
     if ((m_err = git_libgit2_init()) < 0)
         error("failed to initialize libgit2");
@@ -84,7 +88,7 @@ static const size_t REPO_DESC_EST = 64;
 void IndexHtmlGen::generate()
 {
     std::string repos_html;
-    repos_html.reserve((REPO_DESC_EST + REPO_NAME_EST + sizeof(index_line_template)) * m_repos.size());
+    repos_html.reserve((REPO_DESC_EST + REPO_NAME_EST + index_line_template.literal_size()) * m_repos.size());
 
     for (auto &repo_info : m_repos) {
         git_commit *head;
@@ -95,22 +99,21 @@ void IndexHtmlGen::generate()
         if ((m_err = git_commit_lookup(&head, repo_info.repo, &oid_head)) < 0)
             error("failed to retrieve HEAD commit");
 
-        repos_html += fmt::format(
-            index_line_template,
-            fmt::arg("name", repo_info.name),
-            fmt::arg("desc", repo_info.description),
-            fmt::arg("updated", to_string(git_commit_time(head)))
-        );
+        index_line_template.render(repos_html, {
+            repo_info.name,
+            repo_info.description,
+            m_dates.format(git_commit_time(head), git_commit_time_offset(head)),
+        });
 
         git_commit_free(head);
     }
 
-    std::ofstream out_stream("public/index.html", std::ios::out);
-    if (!out_stream.is_open())
-        error("failed to open output file.");
+    bool written = m_output.write("public/index.html", index_page_template.format({
+        repos_html,
+    }), PageKind::Index);
 
-    out_stream << fmt::format(
-        index_page_template,
-        fmt::arg("repos_content", repos_html)
-    );
+    if (!written)
+        error("failed to write output file.");
+    if (!m_output.finish())
+        error("failed to write compressed output");
 }
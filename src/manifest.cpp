@@ -0,0 +1,103 @@
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <fmt/core.h>
+#include <fmt/format.h>
+#include "manifest.h"
+#include "output.h"
+
+void Manifest::add(std::string path, uint64_t hash, uint64_t size)
+{
+    std::lock_guard lock(m_mutex);
+    m_entries.push_back({ std::move(path), hash, size });
+}
+
+void Manifest::sort()
+{
+    // stable so that the last write of a path wins
+    std::stable_sort(m_entries.begin(), m_entries.end(),
+            [](const Entry &a, const Entry &b) { return a.path < b.path; });
+
+    auto last = std::unique(m_entries.rbegin(), m_entries.rend(),
+            [](const Entry &a, const Entry &b) { return a.path == b.path; });
+    m_entries.erase(m_entries.begin(), last.base());
+}
+
+bool Manifest::load(const std::string &path)
+{
+    std::ifstream in_stream(path);
+    if (!in_stream.is_open())
+        return false;
+
+    std::string line;
+    while (std::getline(in_stream, line)) {
+        size_t hash_end = line.find(' ');
+        size_t size_end = line.find(' ', hash_end + 1);
+        if (hash_end == std::string::npos || size_end == std::string::npos)
+            return false;
+
+        try {
+            m_entries.push_back({
+                line.substr(size_end + 1),
+                std::stoull(line.substr(0, hash_end), nullptr, 16),
+                std::stoull(line.substr(hash_end + 1, size_end - hash_end - 1)),
+            });
+        } catch (const std::logic_error &) {
+            return false;
+        }
+    }
+
+    sort();
+    return true;
+}
+
+bool Manifest::save(const std::string &path)
+{
+    sort();
+
+    std::string content;
+    for (auto &entry : m_entries)
+        fmt::format_to(std::back_inserter(content), "{:016x} {} {}\n", entry.hash, entry.size, entry.path);
+
+    return write_file(path, content.data(), content.size());
+}
+
+bool Manifest::save_changes(const Manifest &previous, const std::string &path)
+{
+    std::string content;
+    auto out = std::back_inserter(content);
+
+    auto it = m_entries.begin();
+    auto prev = previous.m_entries.begin();
+    while (it != m_entries.end() || prev != previous.m_entries.end()) {
+        if (prev == previous.m_entries.end() || (it != m_entries.end() && it->path < prev->path)) {
+            fmt::format_to(out, "A {:016x} {}\n", it->hash, it->path);
+            ++it;
+        } else if (it == m_entries.end() || prev->path < it->path) {
+            fmt::format_to(out, "D {:016x} {}\n", prev->hash, prev->path);
+            ++prev;
+        } else {
+            if (it->hash != prev->hash || it->size != prev->size)
+                fmt::format_to(out, "M {:016x} {}\n", it->hash, it->path);
+            ++it;
+            ++prev;
+        }
+    }
+
+    return write_file(path, content.data(), content.size());
+}
+
+const Manifest::Entry *Manifest::find(std::string_view path) const
+{
+    auto it = std::lower_bound(m_entries.begin(), m_entries.end(), path,
+            [](const Entry &entry, std::string_view p) { return entry.path < p; });
+
+    if (it == m_entries.end() || it->path != path)
+        return nullptr;
+    return &*it;
+}
+
+const std::vector<Manifest::Entry> &Manifest::entries() const
+{
+    return m_entries;
+}
@@ -0,0 +1,265 @@
+#include <cstring>
+#include "minify.h"
+
+static const char COMMENT_OPEN[] = "<!--";
+
+// elements whose content is copied verbatim, with the start of their end tag
+// (which must be followed by whitespace, '/' or '>')
+static const struct {
+    const char *name;
+    const char *end;
+} RAW_ELEMENTS[] = {
+    { "pre", "</pre" },
+    { "textarea", "</textarea" },
+    { "script", "</script" },
+    { "style", "</style" },
+};
+
+// elements whitespace next to can be dropped without changing the rendering
+static const char *BLOCK_ELEMENTS[] = {
+    "html", "head", "body", "title", "meta", "link",
+    "div", "p", "pre", "br", "hr",
+    "table", "thead", "tbody", "tfoot", "tr", "td", "th",
+    "ul", "ol", "li", "dl", "dt", "dd",
+    "h1", "h2", "h3", "h4", "h5", "h6",
+};
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+static bool is_name_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
+
+static char lower(char c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A' + 'a';
+    return c;
+}
+
+char *HtmlMinifier::flush_space(char *out)
+{
+    if (m_space)
+        *out++ = m_newline ? '\n' : ' ';
+    m_space = m_newline = false;
+    return out;
+}
+
+char *HtmlMinifier::flush_open(char *out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        *out++ = COMMENT_OPEN[i];
+    return out;
+}
+
+char *HtmlMinifier::flush_held(char *out, bool block)
+{
+    if (m_space && m_after_tag && (m_after_block || block))
+        m_space = m_newline = false;
+    out = flush_space(out);
+
+    for (size_t i = 0; i < m_held_size; i++)
+        *out++ = m_held[i];
+    m_held_size = 0;
+    return out;
+}
+
+char *HtmlMinifier::feed(const char *in, size_t len, char *out)
+{
+    const char *end = in + len;
+
+    while (in < end) {
+        char c = *in;
+
+        switch (m_state) {
+        case State::Text:
+            in++;
+            if (is_space(c)) {
+                m_space = true;
+                m_newline |= c == '\n';
+            } else if (c == '<') {
+                m_state = State::TagOpen;
+                m_open = 1;
+            } else {
+                out = flush_space(out);
+                *out++ = c;
+                m_after_tag = false;
+            }
+            break;
+
+        case State::TagOpen:
+            if (c == COMMENT_OPEN[m_open]) {
+                in++;
+                if (++m_open == sizeof(COMMENT_OPEN) - 1) {
+                    // whitespace around a comment merges into one run
+                    m_state = State::Comment;
+                    m_dashes = 0;
+                }
+                break;
+            }
+
+            if (m_open == 1) {
+                m_state = State::TagName;
+                m_name_size = 0;
+                m_closing = false;
+                m_held[0] = '<';
+                m_held_size = 1;
+            } else {
+                // <!DOCTYPE ...> and other declarations
+                out = flush_space(out);
+                out = flush_open(out, m_open);
+                m_state = State::Tag;
+                m_raw_end = nullptr;
+                m_block = true;
+            }
+            break;
+
+        case State::TagName:
+            if (c == '/' && m_name_size == 0 && !m_closing) {
+                m_closing = true;
+                m_held[m_held_size++] = c;
+                in++;
+                break;
+            }
+            if (is_name_char(c)) {
+                if (m_held_size && m_name_size < MAX_NAME) {
+                    m_name[m_name_size] = lower(c);
+                    m_held[m_held_size++] = c;
+                } else {
+                    // too long for any element we care about
+                    out = flush_held(out, false);
+                    *out++ = c;
+                }
+                m_name_size++;
+                in++;
+                break;
+            }
+            if (m_name_size == 0) {
+                // a stray '<' in text
+                out = flush_held(out, false);
+                m_state = State::Text;
+                m_after_tag = false;
+                break;
+            }
+
+            m_raw_end = nullptr;
+            m_block = false;
+            if (m_name_size <= MAX_NAME) {
+                m_name[m_name_size] = '\0';
+                for (auto &raw : RAW_ELEMENTS) {
+                    if (!m_closing && !strcmp(m_name, raw.name))
+                        m_raw_end = raw.end;
+                }
+                for (auto block : BLOCK_ELEMENTS) {
+                    if (!strcmp(m_name, block))
+                        m_block = true;
+                }
+            }
+            if (m_held_size)
+                out = flush_held(out, m_block);
+            m_state = State::Tag;
+            break;
+
+        case State::Tag:
+            in++;
+            if (m_quote) {
+                if (c == m_quote)
+                    m_quote = 0;
+                *out++ = c;
+            } else if (is_space(c)) {
+                m_space = true;
+            } else if (c == '>') {
+                m_space = false;
+                *out++ = c;
+                m_state = m_raw_end ? State::Raw : State::Text;
+                m_raw_matched = 0;
+                m_after_tag = true;
+                m_after_block = m_block;
+            } else {
+                out = flush_space(out);
+                if (c == '"' || c == '\'')
+                    m_quote = c;
+                *out++ = c;
+            }
+            break;
+
+        case State::Comment:
+            in++;
+            if (c == '>' && m_dashes >= 2)
+                m_state = State::Text;
+            else if (c == '-')
+                m_dashes++;
+            else
+                m_dashes = 0;
+            break;
+
+        case State::Raw:
+            if (!m_raw_end[m_raw_matched]) {
+                // "</pre" only ends the element if the name ends there too,
+                // "</prefix>" is still content
+                m_raw_matched = 0;
+                if (is_space(c) || c == '>' || c == '/') {
+                    // the rest of the end tag is an ordinary tag
+                    m_state = State::Tag;
+                    m_block = !strcmp(m_raw_end, "</pre");
+                    m_raw_end = nullptr;
+                }
+                break;
+            }
+
+            if (m_raw_matched == 0) {
+                const char *lt = (const char *)memchr(in, '<', end - in);
+                const char *stop = lt ? lt : end;
+                memmove(out, in, stop - in);
+                out += stop - in;
+                in = stop;
+                if (!lt)
+                    break;
+                c = *in;
+            }
+
+            if (lower(c) != m_raw_end[m_raw_matched]) {
+                m_raw_matched = 0;
+                if (c != '<') {
+                    *out++ = c;
+                    in++;
+                }
+                break;
+            }
+
+            *out++ = c;
+            in++;
+            m_raw_matched++;
+            break;
+        }
+    }
+
+    return out;
+}
+
+char *HtmlMinifier::finish(char *out)
+{
+    if (m_state == State::TagOpen) {
+        out = flush_space(out);
+        out = flush_open(out, m_open);
+    } else if (m_state == State::TagName) {
+        out = flush_held(out, false);
+    }
+
+    // trailing whitespace after the closing tags of the page
+    if (m_after_tag && m_after_block)
+        m_space = false;
+    return flush_space(out);
+}
+
+void minify_html(std::string &html)
+{
+    HtmlMinifier minifier;
+    char *out = minifier.feed(html.data(), html.size(), html.data());
+    out = minifier.finish(out);
+    html.resize(out - html.data());
+}
@@ -0,0 +1,634 @@
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <zlib.h>
+#include "hash.h"
+#include "minify.h"
+#include "output.h"
+
+#ifdef ZSTD
+#include <zstd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+bool write_file(const fs::path &path, const char *data, size_t size)
+{
+    std::ofstream out_stream(path, std::ios::out | std::ios::binary);
+    if (!out_stream.is_open())
+        return false;
+
+    out_stream.write(data, size);
+    return out_stream.good();
+}
+
+bool gzip_compress(const char *data, size_t size, int level, std::string &out)
+{
+    z_stream stream {};
+    // 15 window bits plus 16 selects the gzip wrapper instead of zlib
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+
+    out.resize(deflateBound(&stream, size));
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = size;
+    stream.next_out = (Bytef *)out.data();
+    stream.avail_out = out.size();
+
+    int ret = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+
+    return ret == Z_STREAM_END;
+}
+
+bool gzip_decompress(const char *data, size_t size, size_t raw_size, std::string &out)
+{
+    z_stream stream {};
+    if (inflateInit2(&stream, 15 + 16) != Z_OK)
+        return false;
+
+    out.resize(raw_size);
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = size;
+    stream.next_out = (Bytef *)out.data();
+    stream.avail_out = out.size();
+
+    int ret = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+
+    return ret == Z_STREAM_END && stream.total_out == raw_size;
+}
+
+#ifdef ZSTD
+bool zstd_compress(const char *data, size_t size, int level, std::string &out)
+{
+    out.resize(ZSTD_compressBound(size));
+    size_t ret = ZSTD_compress(out.data(), out.size(), data, size, level);
+    if (ZSTD_isError(ret))
+        return false;
+
+    out.resize(ret);
+    return true;
+}
+
+bool zstd_decompress(const char *data, size_t size, size_t raw_size, std::string &out)
+{
+    out.resize(raw_size);
+    size_t ret = ZSTD_decompress(out.data(), out.size(), data, size);
+    return !ZSTD_isError(ret) && ret == raw_size;
+}
+#endif
+
+const char *page_kind_name(PageKind kind)
+{
+    switch (kind) {
+    case PageKind::File:    return "file";
+    case PageKind::Tree:    return "tree";
+    case PageKind::Commit:  return "commit";
+    case PageKind::Index:   return "index";
+    case PageKind::Raw:     return "raw";
+    default:                return "unknown";
+    }
+}
+
+// bound the number of queued pages so buffers don't pile up when the
+// generator outpaces compression
+static const size_t JOBS_PER_WORKER = 4;
+
+OutputWriter::OutputWriter(const Options &opt)
+    : m_options(opt)
+{
+    if (manifesting())
+        m_previous.load(m_options.manifest_path);
+    if (bundling())
+        m_bundle = std::make_unique<BundleWriter>(m_options.bundle_path);
+    if (compressing())
+        start_workers();
+}
+
+OutputWriter::~OutputWriter()
+{
+    stop_workers();
+}
+
+bool OutputWriter::bundling() const
+{
+    return !m_options.bundle_path.empty();
+}
+
+bool OutputWriter::compressing() const
+{
+    return m_options.gzip || m_options.zstd || bundling();
+}
+
+bool OutputWriter::manifesting() const
+{
+    return !m_options.manifest_path.empty();
+}
+
+void OutputWriter::start_workers()
+{
+    size_t worker_count = m_options.jobs;
+    if (worker_count == 0)
+        worker_count = std::max(std::thread::hardware_concurrency(), 1u);
+
+    m_max_jobs = worker_count * JOBS_PER_WORKER;
+    m_workers.reserve(worker_count);
+    for (size_t i = 0; i < worker_count; i++)
+        m_workers.emplace_back(&OutputWriter::worker, this);
+}
+
+void OutputWriter::stop_workers()
+{
+    {
+        std::lock_guard lock(m_jobs_mutex);
+        m_stop = true;
+    }
+    m_jobs_cv.notify_all();
+
+    for (auto &worker : m_workers)
+        worker.join();
+    m_workers.clear();
+}
+
+void OutputWriter::worker()
+{
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock lock(m_jobs_mutex);
+            m_jobs_cv.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+            if (m_jobs.empty())
+                return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        m_space_cv.notify_one();
+        job();
+    }
+}
+
+void OutputWriter::enqueue(std::function<void()> &&job)
+{
+    // nothing is left to run the job once the workers are stopped
+    if (m_workers.empty()) {
+        job();
+        return;
+    }
+
+    {
+        std::unique_lock lock(m_jobs_mutex);
+        m_space_cv.wait(lock, [this] { return m_jobs.size() < m_max_jobs; });
+        m_jobs.push_back(std::move(job));
+    }
+    m_jobs_cv.notify_one();
+}
+
+bool OutputWriter::make_parent_dirs(const fs::path &path)
+{
+    fs::path dir = path.parent_path();
+    if (dir.empty() || dir == m_last_dir)
+        return true;
+
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec)
+        return false;
+
+    m_last_dir = dir;
+    return true;
+}
+
+void OutputWriter::own_dir(const fs::path &dir)
+{
+    if (!bundling())
+        m_owned_dirs.push_back(dir);
+}
+
+void OutputWriter::mark_written(const fs::path &path)
+{
+    if (m_owned_dirs.empty())
+        return;
+
+    std::lock_guard lock(m_written_mutex);
+    m_written.insert(path.string());
+}
+
+bool OutputWriter::prune_owned_dirs()
+{
+    std::error_code ec;
+    for (auto &dir : m_owned_dirs) {
+        if (!fs::exists(dir, ec))
+            continue;
+
+        std::vector<fs::path> stale_dirs;
+        for (auto it = fs::recursive_directory_iterator(dir, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+            if (it->is_directory())
+                stale_dirs.push_back(it->path());
+            else if (!m_written.contains(it->path().string()) && fs::remove(it->path(), ec))
+                m_stats.files_removed++;
+        }
+        if (ec)
+            return false;
+
+        // deepest first, fs::remove leaves non-empty directories alone
+        for (auto it = stale_dirs.rbegin(); it != stale_dirs.rend(); ++it)
+            if (fs::is_empty(*it, ec))
+                fs::remove(*it, ec);
+    }
+
+    return true;
+}
+
+void OutputWriter::record(const fs::path &path, uint64_t hash, size_t size)
+{
+    if (manifesting())
+        m_manifest.add(path.lexically_relative("public"), hash, size);
+}
+
+bool OutputWriter::save_manifest()
+{
+    return m_manifest.save(m_options.manifest_path) &&
+        m_manifest.save_changes(m_previous, m_options.manifest_path + ".changes");
+}
+
+static bool file_equals(const fs::path &path, const char *data, size_t size)
+{
+    std::ifstream in_stream(path, std::ios::in | std::ios::binary);
+    if (!in_stream.is_open())
+        return false;
+
+    thread_local std::string existing;
+    existing.resize(size);
+    in_stream.read(existing.data(), size);
+    return (size_t)in_stream.gcount() == size && std::memcmp(existing.data(), data, size) == 0;
+}
+
+bool OutputWriter::unchanged(const fs::path &path, uint64_t hash, const char *data, size_t size)
+{
+    std::error_code ec;
+    uintmax_t existing_size = fs::file_size(path, ec);
+    if (ec || existing_size != size)
+        return false;
+
+    // trust the previous manifest instead of reading the file back
+    if (const Manifest::Entry *entry = m_previous.find(path.lexically_relative("public").string()))
+        return entry->hash == hash && entry->size == size;
+
+    return file_equals(path, data, size);
+}
+
+void OutputWriter::account(PageKind kind, size_t size)
+{
+    std::lock_guard lock(m_budget_mutex);
+    m_stats.kind_bytes[(size_t)kind] += size;
+}
+
+// replaces the bytes accounted up front for a page with its final size
+void OutputWriter::settle(PageKind kind, size_t reserved, size_t size)
+{
+    std::lock_guard lock(m_budget_mutex);
+    m_stats.kind_bytes[(size_t)kind] -= reserved;
+    m_stats.kind_bytes[(size_t)kind] += size;
+}
+
+bool OutputWriter::keep_unchanged(const fs::path &path, PageKind kind)
+{
+    std::error_code ec;
+    uintmax_t size = fs::file_size(path, ec);
+    if (ec)
+        return false;
+
+    mark_written(path);
+    m_stats.files_skipped++;
+    m_stats.bytes_skipped += size;
+    account(kind, size);
+
+    if (!manifesting())
+        return true;
+
+    if (const Manifest::Entry *entry = m_previous.find(path.lexically_relative("public").string())) {
+        record(path, entry->hash, entry->size);
+        return true;
+    }
+
+    std::ifstream in_stream(path, std::ios::in | std::ios::binary);
+    std::string existing(size, '\0');
+    in_stream.read(existing.data(), size);
+    record(path, xxh64(existing.data(), existing.size()), size);
+    return true;
+}
+
+bool OutputWriter::write_changed(const fs::path &path, const char *data, size_t size, uint64_t hash, PageKind kind)
+{
+    if (!write_file(path, data, size))
+        return false;
+
+    mark_written(path);
+    m_stats.files_written++;
+    m_stats.bytes_written += size;
+    account(kind, size);
+    record(path, hash, size);
+    return true;
+}
+
+bool OutputWriter::write_bundled(const fs::path &path, std::string &&content, PageKind kind)
+{
+    if (!m_bundle || !m_bundle->is_open())
+        return false;
+
+    if (manifesting())
+        record(path, xxh64(content.data(), content.size()), content.size());
+
+    // bundle paths are relative to the public/ root
+    std::string bundle_path = path.lexically_relative("public");
+
+    // bytes only count once the bundle holds them, as in write_page()
+    if (content.size() < m_options.compress_min_size) {
+        if (!m_bundle->append(bundle_path, content.data(), content.size(), content.size(), BundleCodec::Raw))
+            return false;
+        m_stats.files_written++;
+        m_stats.bytes_written += content.size();
+        account(kind, content.size());
+        return true;
+    }
+
+    // the page counts at its full size until it is compressed, so the
+    // budget never lets in more than fits
+    account(kind, content.size());
+    auto shared_content = std::make_shared<const std::string>(std::move(content));
+    enqueue([this, bundle_path = std::move(bundle_path), shared_content, kind] {
+        thread_local std::string compressed;
+        BundleCodec codec = BundleCodec::Gzip;
+        bool compressed_ok;
+#ifdef ZSTD
+        if (m_options.zstd) {
+            codec = BundleCodec::Zstd;
+            compressed_ok = zstd_compress(shared_content->data(), shared_content->size(), m_options.zstd_level, compressed);
+        } else
+#endif
+            compressed_ok = gzip_compress(shared_content->data(), shared_content->size(), m_options.gzip_level, compressed);
+
+        if (!compressed_ok || !m_bundle->append(bundle_path, compressed.data(), compressed.size(), shared_content->size(), codec)) {
+            // give back what was accounted up front
+            settle(kind, shared_content->size(), 0);
+            m_failed = true;
+            return;
+        }
+
+        m_stats.files_written++;
+        m_stats.bytes_written += compressed.size();
+        settle(kind, shared_content->size(), compressed.size());
+    });
+
+    return true;
+}
+
+bool OutputWriter::write_object(const fs::path &path, const char *data, size_t size, PageKind kind)
+{
+    uint64_t hash = xxh64(data, size);
+    m_objects[path.string()] = { hash, size, kind };
+
+    if (bundling())
+        return write_bundled(path, std::string(data, size), kind);
+
+    // the name is derived from the content, so the right size means the right bytes
+    std::error_code ec;
+    if (fs::file_size(path, ec) == size && !ec) {
+        mark_written(path);
+        m_stats.files_skipped++;
+        m_stats.bytes_skipped += size;
+        account(kind, size);
+        record(path, hash, size);
+        return true;
+    }
+
+    return make_parent_dirs(path) && write_changed(path, data, size, hash, kind);
+}
+
+bool OutputWriter::link(const fs::path &path, const fs::path &object_path)
+{
+    auto object = m_objects.find(object_path.string());
+    if (object == m_objects.end())
+        return false;
+
+    if (bundling()) {
+        if (!m_bundle)
+            return false;
+        record(path, object->second.hash, object->second.size);
+        m_bundle->alias(path.lexically_relative("public").string(),
+                object_path.lexically_relative("public").string());
+        return true;
+    }
+
+    if (!make_parent_dirs(path))
+        return false;
+
+    std::error_code ec;
+    fs::path relative_target = object_path.lexically_relative(path.parent_path());
+    bool linked = m_options.symlinks
+        ? fs::is_symlink(path, ec) && fs::read_symlink(path, ec) == relative_target
+        : fs::equivalent(path, object_path, ec);
+
+    if (!linked) {
+        ec.clear();
+        fs::remove(path, ec);
+        if (!m_options.symlinks) {
+            ec.clear();
+            fs::create_hard_link(object_path, path, ec);
+        }
+        // hardlinks fail across filesystems, fall back to a symlink
+        if (m_options.symlinks || ec) {
+            ec.clear();
+            fs::create_symlink(relative_target, path, ec);
+        }
+        if (ec)
+            return false;
+        m_stats.links_written++;
+    }
+
+    mark_written(path);
+    record(path, object->second.hash, object->second.size);
+    return true;
+}
+
+void OutputWriter::write_sibling(const fs::path &path, PageKind kind, bool page_unchanged,
+        const std::shared_ptr<const std::string> &content,
+        bool (*compress)(const char *, size_t, int, std::string &), int level)
+{
+    size_t order = m_sibling_count++;
+    if (page_unchanged) {
+        std::error_code ec;
+        uintmax_t size = fs::file_size(path, ec);
+        if (!ec) {
+            std::lock_guard lock(m_siblings_mutex);
+            m_siblings.push_back({ order, path, kind, size, 0, true });
+            return;
+        }
+    }
+
+    enqueue([this, order, path, kind, content, compress, level] {
+        thread_local std::string compressed;
+        if (!compress(content->data(), content->size(), level, compressed) ||
+                !write_file(path, compressed.data(), compressed.size())) {
+            m_failed = true;
+            return;
+        }
+
+        uint64_t hash = xxh64(compressed.data(), compressed.size());
+        std::lock_guard lock(m_siblings_mutex);
+        m_siblings.push_back({ order, path, kind, compressed.size(), hash, false });
+    });
+}
+
+// Siblings are the first thing to go when over budget: once every page is
+// accounted, they are let in in the order of their pages while they fit,
+// and the rest are removed.
+void OutputWriter::settle_siblings()
+{
+    std::sort(m_siblings.begin(), m_siblings.end(),
+        [](const Sibling &a, const Sibling &b) { return a.order < b.order; });
+
+    for (auto &sibling : m_siblings) {
+        if (!fits(sibling.size)) {
+            std::error_code ec;
+            fs::remove(sibling.path, ec);
+            m_stats.siblings_dropped++;
+            continue;
+        }
+
+        if (sibling.unchanged) {
+            keep_unchanged(sibling.path, sibling.kind);
+            continue;
+        }
+
+        mark_written(sibling.path);
+        m_stats.files_written++;
+        m_stats.bytes_written += sibling.size;
+        account(sibling.kind, sibling.size);
+        record(sibling.path, sibling.hash, sibling.size);
+    }
+    m_siblings.clear();
+}
+
+bool OutputWriter::write(const fs::path &path, std::string &&content, PageKind kind)
+{
+    if (m_options.minify)
+        minify_html(content);
+
+    return write_page(path, std::move(content), kind);
+}
+
+bool OutputWriter::write_if_fits(const fs::path &path, std::string &content, PageKind kind, bool &over_budget)
+{
+    if (m_options.minify)
+        minify_html(content);
+
+    size_t reserved = content.size();
+    {
+        std::lock_guard lock(m_budget_mutex);
+        over_budget = m_options.max_bytes && used_bytes() + reserved > m_options.max_bytes;
+        if (over_budget)
+            return false;
+        m_reserved += reserved;
+    }
+
+    bool written = write_page(path, std::move(content), kind);
+
+    std::lock_guard lock(m_budget_mutex);
+    m_reserved -= reserved;
+    return written;
+}
+
+bool OutputWriter::write_page(const fs::path &path, std::string &&content, PageKind kind)
+{
+    if (bundling())
+        return write_bundled(path, std::move(content), kind);
+
+    uint64_t hash = xxh64(content.data(), content.size());
+    bool page_unchanged = unchanged(path, hash, content.data(), content.size());
+
+    if (page_unchanged) {
+        mark_written(path);
+        m_stats.files_skipped++;
+        m_stats.bytes_skipped += content.size();
+        account(kind, content.size());
+        record(path, hash, content.size());
+    } else if (!make_parent_dirs(path) || !write_changed(path, content.data(), content.size(), hash, kind)) {
+        return false;
+    }
+
+    if (!compressing() || content.size() < m_options.compress_min_size)
+        return true;
+
+    // an unchanged page keeps its existing siblings
+    auto shared_content = std::make_shared<const std::string>(std::move(content));
+    if (m_options.gzip)
+        write_sibling(path.string() + ".gz", kind, page_unchanged, shared_content, gzip_compress, m_options.gzip_level);
+#ifdef ZSTD
+    if (m_options.zstd)
+        write_sibling(path.string() + ".zst", kind, page_unchanged, shared_content, zstd_compress, m_options.zstd_level);
+#endif
+
+    return true;
+}
+
+void OutputWriter::abandon()
+{
+    {
+        std::lock_guard lock(m_jobs_mutex);
+        m_jobs.clear();
+    }
+    stop_workers();
+}
+
+bool OutputWriter::finish()
+{
+    stop_workers();
+    settle_siblings();
+    if (m_bundle && (!m_bundle->is_open() || !m_bundle->close()))
+        m_failed = true;
+    m_bundle.reset();
+    if (!prune_owned_dirs())
+        m_failed = true;
+    if (manifesting() && !save_manifest())
+        m_failed = true;
+    return !m_failed;
+}
+
+const OutputWriter::Stats &OutputWriter::stats() const
+{
+    return m_stats;
+}
+
+size_t OutputWriter::output_bytes() const
+{
+    size_t total = 0;
+    for (auto &bytes : m_stats.kind_bytes)
+        total += bytes;
+    return total;
+}
+
+// accounted bytes plus those let in but not yet accounted, with
+// m_budget_mutex held
+size_t OutputWriter::used_bytes() const
+{
+    return output_bytes() + m_reserved;
+}
+
+bool OutputWriter::fits(size_t bytes) const
+{
+    std::lock_guard lock(m_budget_mutex);
+    return m_options.max_bytes == 0 || used_bytes() + bytes <= m_options.max_bytes;
+}
+
+size_t OutputWriter::available() const
+{
+    if (m_options.max_bytes == 0)
+        return SIZE_MAX;
+
+    std::lock_guard lock(m_budget_mutex);
+    size_t total = used_bytes();
+    return total < m_options.max_bytes ? m_options.max_bytes - total : 0;
+}
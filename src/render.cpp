@@ -0,0 +1,37 @@
+#include <list>
+#include <fmt/format.h>
+#include "render.h"
+
+void TemplateArg::append_to(std::string &out) const
+{
+    switch (m_kind) {
+    case Kind::String:
+        out.append(m_str);
+        break;
+    case Kind::Number: {
+        fmt::format_int number(m_number);
+        out.append(number.data(), number.size());
+        break;
+    }
+    case Kind::Writer:
+        m_write(m_writer, out);
+        break;
+    }
+}
+
+void render_template(std::string &out, std::string_view source,
+        std::span<const TemplateOp> ops, const TemplateArg *args)
+{
+    for (auto &op : ops) {
+        out.append(source.data() + op.offset, op.size);
+        if (op.arg != TemplateOp::NO_ARG)
+            args[op.arg].append_to(out);
+    }
+}
+
+CompiledTemplate &new_compiled_template()
+{
+    // a list, so earlier templates never move
+    static std::list<CompiledTemplate> compiled;
+    return compiled.emplace_back();
+}
@@ -1,5 +1,7 @@
 #include <ctime>
+#include <cstring>
 #include <vector>
+#include <optional>
 #include <chrono>
 #include <iomanip>
 #include <fstream>
@@ -13,6 +15,8 @@
 #include "repo.h"
 #include "extra.h"
 #include "templates.h"
+#include "lines.h"
+#include "highlight.h"
 
 #ifdef HIGHLIGHT
 #include "color.h"
@@ -45,12 +49,16 @@ RepoHtmlGen::~RepoHtmlGen()
 void RepoHtmlGen::error(const char *msg)
 {
     fmt::print(stderr, "Error occurred (code: {}): {}\n", m_err, msg);
+    // the compression workers run against m_output, stop them before exiting
+    m_output.abandon();
     cleanup();
     exit(1);
 }
 
 RepoHtmlGen::RepoHtmlGen(const Options &opt)
     : m_options(opt),
+      m_output(opt.output),
+      m_dates(opt.utc),
       m_repo_path(fs::absolute(opt.repo_path))
 {
     if ((m_err = git_libgit2_init()) < 0)
@@ -95,16 +103,24 @@ RepoHtmlGen::RepoHtmlGen(const Options &opt)
     ss << in_stream.rdbuf();
     m_description = escape_string(ss.str());
 
-    m_header_content = fmt::format(
-        header_template,
-        fmt::arg("repo_name", m_repo_name),
-        fmt::arg("repo_desc", m_description),
-        fmt::arg("files_path", '/' + m_repo_name + "/index.html"),
-        fmt::arg("commits_path", '/' + m_repo_name + "/commits.html")
-    );
+    m_header_content = header_template.format({
+        m_repo_name,
+        m_description,
+        '/' + m_repo_name + "/index.html",
+        '/' + m_repo_name + "/commits.html",
+    });
 
-    if (fs::exists("public/" + m_repo_name))
-        fs::remove_all("public/" + m_repo_name);
+#ifdef HIGHLIGHT
+    // source-highlight runs with or without --highlight
+    if (!m_options.highlight_cache.empty())
+#else
+    if (m_options.highlight && !m_options.highlight_cache.empty())
+#endif
+        m_highlight_cache = std::make_unique<HighlightCache>(m_options.highlight_cache,
+            m_options.highlight_cache_max_bytes);
+
+    // pages left over from a previous run are removed once generation is done
+    m_output.own_dir("public/" + m_repo_name);
 }
 
 const git_oid *RepoHtmlGen::head() const
@@ -132,15 +148,16 @@ void RepoHtmlGen::find_readme()
     for (auto &readme_filename : README_FILENAMES) {
         if (!git_revparse_single(&readme_obj, m_repo, ("HEAD:" + readme_filename).c_str())) {
 #ifndef MARKDOWN
-            std::string readme_content;
-            generate_file_code_page(readme_filename, (git_blob *)readme_obj, readme_content);
-            m_readme_content = fmt::format(
-                 file_view_template,
-                 fmt::arg("filename", readme_filename),
-                 fmt::arg("file_content", readme_content),
-                 fmt::arg("file_size", ""),
-                 fmt::arg("file_size_unit", "")
-            );
+            auto write_readme = [&](std::string &out) {
+                generate_file_code_page(readme_filename, (git_blob *)readme_obj, out, true);
+            };
+            file_view().render(m_readme_content, {
+                readme_filename,
+                raw_link(readme_filename),
+                write_readme,
+                "",
+                "",
+            });
 #else
             const char *raw_readme_content =
                 (const char *)git_blob_rawcontent((git_blob *)readme_obj);
@@ -163,21 +180,156 @@ void RepoHtmlGen::find_readme()
 
 void RepoHtmlGen::generate()
 {
+    // raw files come first: whether a blob fits in the budget must be known
+    // before any page links to its raw copy
+    if (m_options.raw) {
+        std::unordered_set<std::string> exported;
+        generate_raw_files(m_tree, exported);
+    }
     find_readme();
     generate_tree_pages(m_tree);
     generate_commit_pages();
+
+    if (!m_output.finish())
+        error("failed to write compressed output");
+
+    if (m_highlight_cache)
+        m_highlight_cache->trim();
+
+    const OutputWriter::Stats &stats = m_output.stats();
+    if (m_degraded.files || m_degraded.diffs || m_degraded.raw || stats.siblings_dropped)
+        fmt::print(stderr, "{}: output budget reached, some content was left out (see --stats)\n", m_repo_name);
+    if (m_degraded.highlight)
+        fmt::print(stderr, "{}: {} files took too long to highlight and are shown as plain text\n",
+            m_repo_name, m_degraded.highlight);
+
+    if (m_options.stats)
+        print_stats();
 }
 
-struct SingleUseBuf : public std::streambuf {
-    SingleUseBuf(char *start, size_t len)
-    {
-        setg(start, start, start + len - 1);
+void RepoHtmlGen::print_stats() const
+{
+    const OutputWriter::Stats &stats = m_output.stats();
+    fmt::print("{}: {} files written ({} bytes), {} unchanged ({} bytes), {} removed, {} links\n",
+        m_repo_name,
+        stats.files_written.load(), stats.bytes_written.load(),
+        stats.files_skipped.load(), stats.bytes_skipped.load(),
+        stats.files_removed.load(), stats.links_written.load());
+
+    fmt::print("{}: {} output bytes:", m_repo_name, m_output.output_bytes());
+    for (size_t kind = 0; kind < (size_t)PageKind::Count; kind++)
+        fmt::print(" {} {}", page_kind_name((PageKind)kind), stats.kind_bytes[kind].load());
+    fmt::print("\n");
+
+    if (m_options.output.max_bytes)
+        fmt::print("{}: over budget: {} compressed siblings dropped, {} raw objects skipped, "
+            "{} commit diffs truncated, {} file views omitted\n",
+            m_repo_name, stats.siblings_dropped.load(), m_degraded.raw, m_degraded.diffs, m_degraded.files);
+
+    if (m_options.highlight_budget_ms)
+        fmt::print("{}: over highlighting time budget: {} files shown as plain text\n",
+            m_repo_name, m_degraded.highlight);
+
+    if (m_options.classify)
+        fmt::print("{}: classified as vendored, generated, minified or LFS: {} file views, {} diffs\n",
+            m_repo_name, m_classified.files, m_classified.diffs);
+
+    if (m_highlight_cache) {
+        const HighlightCache::Stats &cache_stats = m_highlight_cache->stats();
+        fmt::print("{}: highlight cache: {} hits, {} misses, {} stored, {} evicted\n",
+            m_repo_name, cache_stats.hits, cache_stats.misses, cache_stats.stored, cache_stats.evicted);
     }
-};
+}
 
 static const size_t LINE_SIZE_EST = 50;
 
-void RepoHtmlGen::generate_file_code_page(const std::string &filename, git_blob *blob, std::string &html)
+#ifdef HIGHLIGHT
+// source-highlight cannot be stopped within a line, so files with a line
+// longer than this (minified code, most often) are left to plain text
+static const size_t COLOR_MAX_LINE = 0x1000;
+
+static std::unique_ptr<ColorHighlighter> color_highlighter(const std::string &filename, const char *content,
+        size_t size)
+{
+    if (longest_line(content, size) > COLOR_MAX_LINE)
+        return nullptr;
+    return ColorHighlighter::create(filename);
+}
+#endif
+
+// bytes highlighted between checks of the highlighting time budget
+static const size_t BUDGET_CHECK_BYTES = 0x10000;
+
+// cache_name names the highlighter and its version for the cache key, empty
+// when the output is not to be cached
+bool RepoHtmlGen::highlight_file_code(std::string_view cache_name, const LineHighlighter &highlight_line,
+        git_blob *blob, const CpuBudget &budget, std::string &html)
+{
+    const char *raw_content = (const char *)git_blob_rawcontent(blob);
+    size_t filesize = git_blob_rawsize(blob);
+    const Template<2> &line_template = m_options.compact ? file_line_compact_template : file_line_template;
+
+    // the cache holds the highlighted lines, each ended by a newline, so
+    // entries do not depend on the line markup
+    std::string key;
+    std::string highlighted;
+    if (m_highlight_cache && !cache_name.empty()) {
+        char oid_str[GIT_OID_HEXSZ + 1];
+        git_oid_tostr(oid_str, sizeof(oid_str), git_blob_id(blob));
+        key = fmt::format("{}.{}", oid_str, cache_name);
+    }
+
+    std::string_view line;
+    auto write_line = [&](std::string &out) { out += line; };
+
+    if (key.empty() || !m_highlight_cache->load(key, highlighted)) {
+        auto write_highlighted_line = [&](std::string &out) { highlight_line(out, line); };
+        if (!key.empty())
+            highlighted.reserve(filesize * 2);
+
+        LineReader lines(raw_content, filesize);
+        size_t unchecked = 0;
+        while (lines.next(line)) {
+            if (key.empty()) {
+                line_template.render(html, { lines.line_no(), write_highlighted_line });
+            } else {
+                highlight_line(highlighted, line);
+                highlighted += '\n';
+            }
+
+            unchecked += line.size();
+            if (unchecked >= BUDGET_CHECK_BYTES) {
+                if (budget.exceeded())
+                    return false;
+                unchecked = 0;
+            }
+        }
+
+        // a last stretch shorter than BUDGET_CHECK_BYTES, or one long line,
+        // may still have run over
+        if (budget.exceeded())
+            return false;
+        if (key.empty())
+            return true;
+        m_highlight_cache->store(key, highlighted);
+    }
+
+    const char *pos = highlighted.data();
+    const char *end = pos + highlighted.size();
+    size_t line_no = 0;
+    while (pos < end) {
+        const char *newline = (const char *)memchr(pos, '\n', end - pos);
+        if (!newline)
+            newline = end;
+        line = std::string_view(pos, newline - pos);
+        line_template.render(html, { ++line_no, write_line });
+        pos = newline + 1;
+    }
+    return true;
+}
+
+void RepoHtmlGen::generate_file_code_page(const std::string &filename, git_blob *blob, std::string &html,
+        bool allow_highlight)
 {
     char *raw_content = (char *)git_blob_rawcontent(blob);
     size_t filesize = git_blob_rawsize(blob);
@@ -186,27 +338,195 @@ void RepoHtmlGen::generate_file_code_page(const std::string &filename, git_blob
         return;
     }
 
-    SingleUseBuf buf(raw_content, filesize);
-    std::istream in_stream(&buf);
-#ifndef HIGHLIGHT
-    html.reserve(filesize + (filesize / LINE_SIZE_EST) * sizeof(file_line_template));
+    const Language *lang = nullptr;
+    if (allow_highlight && m_options.highlight)
+        lang = find_language(filename, std::string_view(raw_content, filesize));
+
+    const Template<2> &line_template = m_options.compact ? file_line_compact_template : file_line_template;
+    size_t line_count = count_lines(raw_content, filesize);
+    // highlighted markup is about as large again as the code itself
+    size_t markup_est = lang ? filesize : 0;
+    html.reserve(html.size() + filesize + markup_est + line_count * line_template.literal_size());
+
+    // past the budget, whatever was highlighted is dropped for plain text
+    size_t start = html.size();
+    CpuBudget budget(m_options.highlight_budget_ms);
+
+    if (lang) {
+        Highlighter highlighter(*lang);
+        auto highlight_line = [&](std::string &out, std::string_view line) { highlighter.highlight_line(out, line); };
+        if (highlight_file_code(fmt::format("{}.{}", language_name(*lang), HIGHLIGHTER_VERSION),
+                highlight_line, blob, budget, html))
+            return;
+        html.resize(start);
+        m_degraded.highlight++;
+    }
 
-    std::string line;
-    size_t line_no = 0;
-    while (std::getline(in_stream, line)) {
-        line_no++;
-        html += fmt::format(
-            file_line_template,
-            fmt::arg("line", escape_string(line))
-        );
+#ifdef HIGHLIGHT
+    // source-highlight covers whatever the built-in lexers do not
+    std::unique_ptr<ColorHighlighter> color;
+    if (!lang && allow_highlight && (color = color_highlighter(filename, raw_content, filesize))) {
+        auto highlight_line = [&](std::string &out, std::string_view line) { color->highlight_line(out, line); };
+        // keyed by the language definition file, e.g. "oid.cpp.lang.1"
+        if (highlight_file_code(fmt::format("{}.{}", color->lang(), COLOR_VERSION),
+                highlight_line, blob, budget, html))
+            return;
+        html.resize(start);
+        m_degraded.highlight++;
     }
-#else
-    std::stringbuf obuf;
-    std::ostream out_stream(&obuf);
- 
-    highlight(filename, in_stream, out_stream);
-    html = std::move(obuf.str());
 #endif
+
+    LineReader lines(raw_content, filesize);
+    std::string_view line;
+    auto write_line = [&](std::string &out) { escape_html(out, line); };
+    while (lines.next(line))
+        line_template.render(html, { lines.line_no(), write_line });
+}
+
+const Template<5> &RepoHtmlGen::file_view() const
+{
+    return m_options.compact ? file_view_compact_template : file_view_template;
+}
+
+// Path of the page of a chunk of a file, relative to public/. The first is
+// the file's usual page; the others go under chunks/, where nothing else is
+// written, as chunks/<file path>/<n>.html. A file and a directory cannot
+// share a path, so these never collide with each other either.
+static std::string chunk_page_path(const std::string &repo_name, const fs::path &file_path, size_t chunk)
+{
+    if (chunk == 0)
+        return fmt::format("{}/files/{}.html", repo_name, std::string(file_path));
+    return fmt::format("{}/chunks/{}/{}.html", repo_name, std::string(file_path), chunk + 1);
+}
+
+// Files over max_view_filesize are shown as pages of view_chunk_lines lines
+// each, the first at the file's usual page. Lines are numbered across the
+// whole file and anchored as L<n>, so a line keeps its link. Each page is
+// rendered and handed to the output before the next is started, and the
+// highlighter carries its state from one chunk to the next, so the pages
+// look as one view of the file would.
+void RepoHtmlGen::generate_file_chunk_pages(const fs::path &file_path, const char *filename, git_blob *blob,
+        bool allow_highlight)
+{
+    const char *raw_content = (const char *)git_blob_rawcontent(blob);
+    size_t filesize = git_blob_rawsize(blob);
+    size_t line_count = count_lines(raw_content, filesize);
+    size_t chunk_lines = m_options.view_chunk_lines;
+    size_t chunk_count = std::max<size_t>((line_count + chunk_lines - 1) / chunk_lines, 1);
+
+    const Language *lang = nullptr;
+    if (allow_highlight && m_options.highlight)
+        lang = find_language(filename, std::string_view(raw_content, filesize));
+    std::optional<Highlighter> highlighter;
+    LineHighlighter highlight_line;
+    if (lang) {
+        highlighter.emplace(*lang);
+        highlight_line = [&](std::string &out, std::string_view line) { highlighter->highlight_line(out, line); };
+    }
+#ifdef HIGHLIGHT
+    std::unique_ptr<ColorHighlighter> color;
+    if (!lang && allow_highlight && (color = color_highlighter(filename, raw_content, filesize)))
+        highlight_line = [&](std::string &out, std::string_view line) { color->highlight_line(out, line); };
+#endif
+
+    // the budget covers the whole file; past it, the rest is plain text
+    CpuBudget budget(m_options.highlight_budget_ms);
+    size_t unchecked = 0;
+
+    const Template<7> &chunk_view = m_options.compact ? file_chunk_view_compact_template : file_chunk_view_template;
+    const Template<2> &line_template = m_options.compact ? file_line_compact_template : file_line_template;
+
+    auto size_info = format_filesize(filesize);
+    std::string file_raw_link = raw_link(file_path);
+
+    LineReader lines(raw_content, filesize);
+    std::string_view line;
+    auto write_plain_line = [&](std::string &out) { escape_html(out, line); };
+    auto write_highlighted_line = [&](std::string &out) { highlight_line(out, line); };
+
+    std::string page;
+    for (size_t chunk = 0; chunk < chunk_count; chunk++) {
+        size_t first = chunk * chunk_lines;
+        size_t last = std::min(first + chunk_lines, line_count);
+
+        bool omitted = false;
+        auto write_chunk = [&](std::string &out) {
+            if (omitted) {
+                out += budget_file_omitted;
+                return;
+            }
+            while (lines.line_no() < last && lines.next(line)) {
+                if (!highlight_line) {
+                    line_template.render(out, { lines.line_no(), write_plain_line });
+                    continue;
+                }
+
+                line_template.render(out, { lines.line_no(), write_highlighted_line });
+                unchecked += line.size();
+                if (unchecked >= BUDGET_CHECK_BYTES) {
+                    if (budget.exceeded()) {
+                        highlight_line = nullptr;
+                        m_degraded.highlight++;
+                    }
+                    unchecked = 0;
+                }
+            }
+        };
+
+        auto link = [&](size_t to) { return '/' + chunk_page_path(m_repo_name, file_path, to); };
+        auto write_links = [&](std::string &out) {
+            if (chunk > 0) {
+                file_chunk_link_template.render(out, { link(0), "first" });
+                file_chunk_link_template.render(out, { link(chunk - 1), "previous" });
+            }
+            if (chunk + 1 < chunk_count) {
+                file_chunk_link_template.render(out, { link(chunk + 1), "next" });
+                file_chunk_link_template.render(out, { link(chunk_count - 1), "last" });
+            }
+        };
+        std::string chunk_nav;
+        file_chunk_nav_template.render(chunk_nav, { write_links, first + 1, last, line_count });
+
+        auto write_file_view = [&](std::string &out) {
+            chunk_view.render(out, {
+                filename,
+                file_raw_link,
+                chunk_nav,
+                write_chunk,
+                size_info.first,
+                size_info.second,
+                first,
+            });
+        };
+
+        auto render_page = [&] {
+            page.clear();
+            file_page_template.render(page, {
+                m_header_content,
+                m_repo_name,
+                filename,
+                write_file_view,
+            });
+        };
+
+        fs::path page_path = "public/" + chunk_page_path(m_repo_name, file_path, chunk);
+        page.reserve(std::min(filesize, chunk_lines * LINE_SIZE_EST * 2));
+        render_page();
+        // the lines of an omitted chunk have still been read, which keeps
+        // the highlighter in step for the chunks after it
+        bool over_budget;
+        bool written = m_output.write_if_fits(page_path, page, PageKind::File, over_budget);
+        if (over_budget) {
+            omitted = true;
+            render_page();
+            m_degraded.files++;
+            written = m_output.write(page_path, std::move(page), PageKind::File);
+        }
+
+        if (!written)
+            error("failed to write output file.");
+        page = std::string();
+    }
 }
 
 void RepoHtmlGen::generate_file_page(const fs::path &file_path, const git_tree_entry *entry)
@@ -214,41 +534,90 @@ void RepoHtmlGen::generate_file_page(const fs::path &file_path, const git_tree_e
     const char *entry_name = git_tree_entry_name(entry);
 
     fs::path html_path = "public/" + m_repo_name + "/files/" + std::string(file_path) + ".html";
-    if (!fs::exists(html_path.parent_path()))
-        fs::create_directories(html_path.parent_path());
 
     git_object *obj;
     if ((m_err = git_object_lookup(&obj, m_repo, git_tree_entry_id(entry), GIT_OBJ_ANY)) < 0)
         error("failed to lookup git object from index entry");
 
-    std::string html_file_content;
-    if (git_blob_is_binary((git_blob *)obj))
-        html_file_content = "This is a binary file.";
-    else
-        generate_file_code_page(entry_name, (git_blob *)obj, html_file_content);
+    git_blob *blob = (git_blob *)obj;
+    bool binary = git_blob_is_binary(blob);
+
+    // vendored, generated and minified files are shown without highlighting
+    // and Git LFS pointers as a card of the object they point to
+    ContentClass content_class = ContentClass::Normal;
+    if (m_options.classify && !binary) {
+        std::string_view content((const char *)git_blob_rawcontent(blob), git_blob_rawsize(blob));
+        content_class = classify_file(m_repo, std::string(file_path).c_str(), content);
+        if (content_class != ContentClass::Normal)
+            m_classified.files++;
+    }
+    bool highlight = content_class == ContentClass::Normal;
 
-    std::ofstream out_stream(html_path, std::ios::out);
-    if (!out_stream.is_open())
-        error("failed to open output file.");
+    size_t filesize = git_blob_rawsize(blob);
+    bool chunked = m_options.view_chunk_lines && filesize >= m_options.max_view_filesize
+        && (!m_options.max_chunked_filesize || filesize < m_options.max_chunked_filesize);
+    if (chunked && !binary) {
+        generate_file_chunk_pages(file_path, entry_name, blob, highlight);
+        git_object_free(obj);
+        return;
+    }
+
+    bool omitted = false;
+    auto write_file_content = [&](std::string &out) {
+        LfsPointer pointer;
+        if (omitted) {
+            out += budget_file_omitted;
+        } else if (binary) {
+            out += "This is a binary file.";
+        } else if (content_class == ContentClass::LfsPointer
+                && parse_lfs_pointer({ (const char *)git_blob_rawcontent(blob), git_blob_rawsize(blob) }, pointer)) {
+            auto object_size = format_filesize(pointer.size);
+            auto write_oid = [&](std::string &out) { escape_html(out, pointer.oid); };
+            file_lfs_card_template.render(out, { write_oid, object_size.first, object_size.second });
+        } else {
+            generate_file_code_page(entry_name, blob, out, highlight);
+        }
+    };
 
     auto size_info = format_filesize(git_blob_rawsize((git_blob *)obj));
-    out_stream << fmt::format(
-        file_page_template,
-        fmt::arg("header_content", m_header_content),
-        fmt::arg("repo_name", m_repo_name),
-        fmt::arg("filename", entry_name),
-        fmt::arg("fileview_content",
-            fmt::format(
-                file_view_template,
-                fmt::arg("filename", entry_name),
-                fmt::arg("file_content", html_file_content),
-                fmt::arg("file_size", size_info.first),
-                fmt::arg("file_size_unit", size_info.second)
-            )
-        )
-    );
+    std::string file_raw_link = raw_link(file_path);
+    auto write_file_view = [&](std::string &out) {
+        file_view().render(out, {
+            entry_name,
+            file_raw_link,
+            write_file_content,
+            size_info.first,
+            size_info.second,
+        });
+    };
+
+    // the file view is rendered straight into the page, so its content is
+    // never copied into an intermediate string
+    std::string page;
+    auto render_page = [&] {
+        page.clear();
+        file_page_template.render(page, {
+            m_header_content,
+            m_repo_name,
+            entry_name,
+            write_file_view,
+        });
+    };
+
+    render_page();
+    bool over_budget;
+    bool written = m_output.write_if_fits(html_path, page, PageKind::File, over_budget);
+    if (over_budget) {
+        omitted = true;
+        render_page();
+        m_degraded.files++;
+        written = m_output.write(html_path, std::move(page), PageKind::File);
+    }
 
     git_object_free(obj);
+
+    if (!written)
+        error("failed to write output file.");
 }
 
 void RepoHtmlGen::generate_tree_pages(git_tree *tree, std::string root)
@@ -256,17 +625,11 @@ void RepoHtmlGen::generate_tree_pages(git_tree *tree, std::string root)
     fs::path html_path =
         root == "" ? "public/" + m_repo_name + "/index.html"
                    : "public/" + m_repo_name + "/tree/" + root + "index.html";
-    if (!fs::exists(html_path.parent_path()))
-        fs::create_directories(html_path.parent_path());
-
-    std::ofstream out_stream(html_path, std::ios::out);
-    if (!out_stream.is_open())
-        error("failed to open output file.");
 
     size_t tree_entry_count = git_tree_entrycount(tree);
 
     std::string tree_html;
-    tree_html.reserve(tree_entry_count * sizeof(file_tree_line_template));
+    tree_html.reserve(tree_entry_count * file_tree_line_template.literal_size());
     for (size_t i = 0; i < tree_entry_count; i++) {
         const char *entry_name;
         const git_tree_entry *entry = nullptr;
@@ -283,11 +646,10 @@ void RepoHtmlGen::generate_tree_pages(git_tree *tree, std::string root)
 
         if (git_tree_entry_type(entry) == GIT_OBJ_TREE) {
             generate_tree_pages((git_tree *)obj, root + entry_name + '/');
-            tree_html += fmt::format(
-                file_tree_line_dir_template,
-                fmt::arg("file_tree_name", entry_name),
-                fmt::arg("file_tree_link", '/' + m_repo_name + "/tree/" + root + entry_name)
-            );
+            file_tree_line_dir_template.render(tree_html, {
+                entry_name,
+                '/' + m_repo_name + "/tree/" + root + entry_name,
+            });
             git_object_free(obj);
             continue;
         }
@@ -295,95 +657,667 @@ void RepoHtmlGen::generate_tree_pages(git_tree *tree, std::string root)
         generate_file_page(root + entry_name, entry);
 
         auto size_info = format_filesize(git_blob_rawsize((git_blob *)obj));
-        tree_html += fmt::format(
-            file_tree_line_template,
-            fmt::arg("file_tree_name", entry_name),
-            fmt::arg("file_tree_size", size_info.first),
-            fmt::arg("file_tree_size_unit", size_info.second),
-            fmt::arg("file_tree_link", '/' + m_repo_name + "/files/" + root + entry_name + ".html")
-        );
+        file_tree_line_template.render(tree_html, {
+            entry_name,
+            size_info.first,
+            size_info.second,
+            '/' + m_repo_name + "/files/" + root + entry_name + ".html",
+        });
 
         git_object_free(obj);
     }
 
-    out_stream << fmt::format(
-        file_index_template,
-        fmt::arg("repo_name", m_repo_name),
-        fmt::arg("header_content", m_header_content),
-        fmt::arg("readme_content", root == "" ? m_readme_content : ""),
-        fmt::arg("tree_content", tree_html),
-        fmt::arg("tree_path", root)
-    );
+    bool written = m_output.write(html_path, file_index_template.format({
+        m_repo_name,
+        m_header_content,
+        root == "" ? std::string_view(m_readme_content) : "",
+        tree_html,
+        root,
+    }), PageKind::Tree);
+
+    if (!written)
+        error("failed to write output file.");
+}
+
+std::string RepoHtmlGen::raw_link(const fs::path &file_path) const
+{
+    // only raw/files/<path> links that generate_raw_files() made
+    if (!m_options.raw || !m_raw_files.contains(std::string(file_path)))
+        return "";
+
+    return file_raw_link_template.format({
+        '/' + m_repo_name + "/raw/files/" + std::string(file_path),
+    });
+}
+
+void RepoHtmlGen::generate_raw_files(git_tree *tree, std::unordered_set<std::string> &exported, std::string root)
+{
+    size_t tree_entry_count = git_tree_entrycount(tree);
+    for (size_t i = 0; i < tree_entry_count; i++) {
+        const git_tree_entry *entry = nullptr;
+        git_object *obj;
+
+        if (!(entry = git_tree_entry_byindex(tree, i)))
+            error("failed to retrieve tree entry");
+        if (git_tree_entry_type(entry) == GIT_OBJ_COMMIT)
+            continue;
+
+        std::string entry_path = root + git_tree_entry_name(entry);
+
+        if (git_tree_entry_type(entry) == GIT_OBJ_TREE) {
+            if ((m_err = git_tree_entry_to_object(&obj, m_repo, entry)) < 0)
+                error("failed to convert tree entry to object");
+            generate_raw_files((git_tree *)obj, exported, entry_path + '/');
+            git_object_free(obj);
+            continue;
+        }
+
+        char oid_str[GIT_OID_HEXSZ + 1];
+        git_oid_tostr(oid_str, sizeof(oid_str), git_tree_entry_id(entry));
+        std::string object_path = "public/" + m_repo_name + "/raw/objects/" + oid_str;
+
+        // each blob is stored once, every path naming it links to that copy
+        if (!exported.contains(oid_str)) {
+            if ((m_err = git_tree_entry_to_object(&obj, m_repo, entry)) < 0)
+                error("failed to convert tree entry to object");
+
+            size_t size = git_blob_rawsize((git_blob *)obj);
+            if (!m_output.fits(size)) {
+                git_object_free(obj);
+                m_degraded.raw++;
+                continue;
+            }
+
+            bool written = m_output.write_object(object_path,
+                (const char *)git_blob_rawcontent((git_blob *)obj), size, PageKind::Raw);
+            git_object_free(obj);
+            if (!written)
+                error("failed to write raw object.");
+            exported.insert(oid_str);
+        }
+
+        if (!m_output.link("public/" + m_repo_name + "/raw/files/" + entry_path, object_path))
+            error("failed to link raw file.");
+        m_raw_files.insert(entry_path);
+    }
 }
 
+// Diff line templates are split around their content slot once, so lines
+// can be escaped straight into the page buffer without temporaries.
+struct DiffLineMarkup {
+    DiffLineMarkup(std::string_view templ)
+    {
+        size_t slot = templ.rfind("{}");
+        open = templ.substr(0, slot);
+        close = templ.substr(slot + 2);
+    }
+
+    std::string_view open;
+    std::string_view close;
+};
+
+static const DiffLineMarkup DIFF_LINE_MARKUP(diff_line_template);
+static const DiffLineMarkup DIFF_ADD_MARKUP(diff_add_template);
+static const DiffLineMarkup DIFF_DEL_MARKUP(diff_del_template);
+static const DiffLineMarkup DIFF_ADD_EOFNL_MARKUP(diff_add_eofnl_template);
+static const DiffLineMarkup DIFF_DEL_EOFNL_MARKUP(diff_del_eofnl_template);
+static const DiffLineMarkup DIFF_FILE_HDR_MARKUP(diff_file_hdr_template);
+static const DiffLineMarkup DIFF_HUNK_HDR_MARKUP(diff_hunk_hdr_template);
+static const DiffLineMarkup DIFF_HUNK_COMPACT_MARKUP(diff_hunk_compact_template);
+static const DiffLineMarkup DIFF_ADD_RUN_MARKUP(diff_add_run_template);
+static const DiffLineMarkup DIFF_DEL_RUN_MARKUP(diff_del_run_template);
+static const DiffLineMarkup DIFF_CHANGED_MARKUP(diff_changed_template);
+
 struct diff_printer_passthrough {
-    diff_printer_passthrough(size_t max)
-        : max_line_no(max)
+    diff_printer_passthrough(std::string &html, size_t max, size_t max_bytes, bool compact, bool highlight)
+        : html(html),
+          max_line_no(max),
+          max_bytes(max_bytes),
+          compact(compact),
+          highlight(highlight)
     {
     }
 
-    std::string html;
+    // the commit page being rendered, the diff is appended in place
+    std::string &html;
     const size_t max_line_no;
+    const size_t max_bytes;
+    const bool compact;
+    bool over_budget { false };
     size_t line_hunk_hdr_no { 0 };
     size_t line_no { 0 };
+
+    // compact mode puts each hunk in one pre block, with consecutive added
+    // or deleted lines grouped into a single run element
+    bool in_hunk { false };
+    const DiffLineMarkup *run { nullptr };
+
+    // with highlighting, the language of the file being printed and a lexer
+    // for each side of the diff, restarted at every hunk; context lines go
+    // through both
+    const bool highlight;
+    const Language *lang { nullptr };
+    std::optional<Highlighter> old_side;
+    std::optional<Highlighter> new_side;
+    std::string discarded;
+
+    // added and deleted lines are held back until their run ends, so that
+    // the n-th deleted line can be compared with the n-th added one
+    struct PendingLine {
+        char origin;
+        int old_lineno;
+        int new_lineno;
+        std::string content;
+        bool marked;
+        LineMark mark;
+        size_t text_begin;
+        size_t text_end;
+    };
+
+    std::vector<PendingLine> pending;
+    size_t pending_count { 0 };
+    size_t pending_bytes { 0 };
+
+    // the side-by-side view, built in the same pass: its cells are copied
+    // from the unified view, where print_diff_content leaves the range of
+    // the last line text it wrote
+    std::string *split { nullptr };
+    bool in_split_table { false };
+    size_t text_begin { 0 };
+    size_t text_end { 0 };
+
+    // files whose diff is replaced by a summary, by the delta that
+    // git_diff_print passes along with their lines
+    struct SummaryDelta {
+        const git_diff_delta *delta;
+        ContentClass content_class;
+        size_t gain, loss;
+    };
+    std::vector<SummaryDelta> summaries;
+    bool skip_file { false };
+
+    void close_run()
+    {
+        if (run)
+            html += run->close;
+        run = nullptr;
+    }
+
+    void close_hunk()
+    {
+        close_run();
+        if (in_hunk)
+            html += DIFF_HUNK_COMPACT_MARKUP.close;
+        in_hunk = false;
+    }
+
+    void close_split_table()
+    {
+        if (in_split_table)
+            *split += diff_split_end;
+        in_split_table = false;
+    }
+
+    // closes everything open and ends both views with message
+    void finish(const char *message)
+    {
+        close_hunk();
+        html += message;
+        if (split) {
+            close_split_table();
+            *split += message;
+        }
+    }
 };
 
-static int diff_printer(const git_diff_delta *, const git_diff_hunk *,
-        const git_diff_line *line, void *void_pass)
+static void start_diff_file(diff_printer_passthrough *passthrough, const git_diff_delta *delta)
 {
-    diff_printer_passthrough *passthrough = (diff_printer_passthrough *)void_pass;
-    if (++passthrough->line_no >= passthrough->max_line_no) {
-        passthrough->html += diff_max_line_count;
-        return 1;
+    const char *path = delta->status == GIT_DELTA_DELETED ? delta->old_file.path : delta->new_file.path;
+    std::string_view filename = path ? path : "";
+    filename.remove_prefix(filename.rfind('/') + 1);
+
+    passthrough->lang = find_language(filename, {});
+    passthrough->old_side.reset();
+    passthrough->new_side.reset();
+}
+
+static void start_diff_hunk(diff_printer_passthrough *passthrough)
+{
+    if (!passthrough->lang)
+        return;
+    passthrough->old_side.emplace(*passthrough->lang);
+    passthrough->new_side.emplace(*passthrough->lang);
+}
+
+static bool is_diff_content(const git_diff_line *line)
+{
+    return line->origin == GIT_DIFF_LINE_ADDITION || line->origin == GIT_DIFF_LINE_DELETION ||
+        line->origin == GIT_DIFF_LINE_CONTEXT;
+}
+
+// a diff line without its line ending
+static std::string_view diff_line_text(std::string_view content)
+{
+    size_t len = content.size();
+    while (len && (content[len - 1] == '\n' || content[len - 1] == '\r'))
+        len--;
+    return content.substr(0, len);
+}
+
+// Writes the text of an added, deleted or context line, highlighted when
+// the file has a language, with the changed part marked if there is one.
+static void print_diff_content(diff_printer_passthrough *passthrough, const git_diff_line *line,
+        const LineMark *mark)
+{
+    std::string &html = passthrough->html;
+    std::string_view content(line->content, line->content_len);
+
+    // the line ending stays outside of the highlighted or marked text
+    std::string_view text = diff_line_text(content);
+    passthrough->text_begin = html.size();
+    if (!passthrough->new_side) {
+        // an empty mark is left out, as Highlighter does
+        if (mark && mark->begin < mark->end) {
+            escape_html(html, text.substr(0, mark->begin));
+            html += mark->open;
+            escape_html(html, text.substr(mark->begin, mark->end - mark->begin));
+            html += mark->close;
+            escape_html(html, text.substr(mark->end));
+        } else {
+            escape_html(html, text);
+        }
+        passthrough->text_end = html.size();
+        html += content.substr(text.size());
+        return;
+    }
+
+    Highlighter &old_side = *passthrough->old_side;
+    Highlighter &new_side = *passthrough->new_side;
+    if (line->origin == GIT_DIFF_LINE_DELETION) {
+        old_side.highlight_line(html, text, mark);
+    } else if (line->origin == GIT_DIFF_LINE_ADDITION) {
+        new_side.highlight_line(html, text, mark);
+    } else if (old_side.same_state(new_side)) {
+        new_side.highlight_line(html, text);
+        old_side.copy_state(new_side);
+    } else {
+        new_side.highlight_line(html, text);
+        passthrough->discarded.clear();
+        old_side.highlight_line(passthrough->discarded, text);
+    }
+    passthrough->text_end = html.size();
+    html += content.substr(text.size());
+}
+
+// one side of a row of the side-by-side view
+struct SplitCell {
+    int lineno;
+    const char *kind;
+    size_t text_begin;
+    size_t text_end;
+};
+
+static void print_split_row(diff_printer_passthrough *passthrough, const SplitCell *old_cell,
+        const SplitCell *new_cell)
+{
+    const std::string &html = passthrough->html;
+    auto write_old = [&](std::string &out) {
+        if (old_cell)
+            out.append(html, old_cell->text_begin, old_cell->text_end - old_cell->text_begin);
+    };
+    auto write_new = [&](std::string &out) {
+        if (new_cell)
+            out.append(html, new_cell->text_begin, new_cell->text_end - new_cell->text_begin);
+    };
+    auto lineno = [](const SplitCell *cell) {
+        return cell && cell->lineno > 0 ? TemplateArg(cell->lineno) : TemplateArg("");
+    };
+
+    diff_split_row_template.render(*passthrough->split, {
+        lineno(old_cell),
+        old_cell ? old_cell->kind : "diff_empty",
+        write_old,
+        lineno(new_cell),
+        new_cell ? new_cell->kind : "diff_empty",
+        write_new,
+    });
+}
+
+static void print_split_hunk_hdr(diff_printer_passthrough *passthrough, size_t hunk_no,
+        const git_diff_line *line)
+{
+    std::string &split = *passthrough->split;
+    if (!passthrough->in_split_table)
+        split += diff_split_begin;
+    passthrough->in_split_table = true;
+
+    std::string_view header = diff_line_text(std::string_view(line->content, line->content_len));
+    auto write_header = [&](std::string &out) { escape_html(out, header); };
+    diff_split_hunk_hdr_template.render(split, { hunk_no, write_header });
+}
+
+static void print_hunk_hdr(diff_printer_passthrough *passthrough, const git_diff_line *line)
+{
+    std::string &html = passthrough->html;
+
+    // the opening part still holds the two hunk number slots
+    fmt::format_to(std::back_inserter(html), DIFF_HUNK_HDR_MARKUP.open,
+        passthrough->line_hunk_hdr_no,
+        passthrough->line_hunk_hdr_no);
+    passthrough->line_hunk_hdr_no++;
+
+    escape_html(html, line->content, line->content_len);
+    html += DIFF_HUNK_HDR_MARKUP.close;
+}
+
+static void print_compact_line(diff_printer_passthrough *passthrough, const git_diff_line *line,
+        const LineMark *mark)
+{
+    std::string &html = passthrough->html;
+
+    const DiffLineMarkup *run = nullptr;
+    if (line->origin == GIT_DIFF_LINE_ADDITION)
+        run = &DIFF_ADD_RUN_MARKUP;
+    else if (line->origin == GIT_DIFF_LINE_DELETION)
+        run = &DIFF_DEL_RUN_MARKUP;
+
+    if (run != passthrough->run) {
+        passthrough->close_run();
+        if (run)
+            html += run->open;
+        passthrough->run = run;
     }
 
-    const char *diff_template;
+    // the "\ No newline at end of file" lines carry their own text
+    if (is_diff_content(line)) {
+        html += line->origin;
+        print_diff_content(passthrough, line, mark);
+    } else {
+        escape_html(html, line->content, line->content_len);
+    }
+}
+
+static void print_diff_line(diff_printer_passthrough *passthrough, const git_diff_line *line,
+        const LineMark *mark)
+{
+    std::string &html = passthrough->html;
+    if (passthrough->compact && line->origin != GIT_DIFF_LINE_FILE_HDR) {
+        print_compact_line(passthrough, line, mark);
+        return;
+    }
+
+    const DiffLineMarkup *markup;
     switch (line->origin) {
     case GIT_DIFF_LINE_ADDITION:
-        diff_template = diff_add_template;
+        markup = &DIFF_ADD_MARKUP;
         break;
     case GIT_DIFF_LINE_DELETION:
-        diff_template = diff_del_template;
+        markup = &DIFF_DEL_MARKUP;
         break;
     case GIT_DIFF_LINE_ADD_EOFNL:
-        diff_template = diff_add_eofnl_template;
+        markup = &DIFF_ADD_EOFNL_MARKUP;
         break;
     case GIT_DIFF_LINE_DEL_EOFNL:
-        diff_template = diff_del_eofnl_template;
+        markup = &DIFF_DEL_EOFNL_MARKUP;
         break;
     case GIT_DIFF_LINE_FILE_HDR:
-        diff_template = diff_file_hdr_template;
+        markup = &DIFF_FILE_HDR_MARKUP;
         break;
-    case GIT_DIFF_LINE_HUNK_HDR:
-        passthrough->html += fmt::format(
-            diff_hunk_hdr_template,
-            passthrough->line_hunk_hdr_no,
-            passthrough->line_hunk_hdr_no,
-            line->content,
-            line->content_len
-        );
-        passthrough->line_hunk_hdr_no++;
-        return 0;
     default:
-        diff_template = diff_line_template;
+        markup = &DIFF_LINE_MARKUP;
         break;
     }
 
-    passthrough->html += fmt::format(
-        diff_template,
-        escape_string(std::string(line->content, line->content_len))
-    );
+    html += markup->open;
+    if (is_diff_content(line))
+        print_diff_content(passthrough, line, mark);
+    else
+        escape_html(html, line->content, line->content_len);
+    html += markup->close;
+}
+
+// lines longer than this are not compared for their changed part
+static const size_t WORD_DIFF_MAX_LINE = 1024;
+
+static bool is_word_char(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+        c == '_' || (unsigned char)c >= 0x80;
+}
+
+// Finds what changed between two versions of a line: whatever lies between
+// their common prefix and suffix, widened so that no word (or UTF-8
+// sequence) is split. Linear in the line lengths. Returns false when the
+// lines share neither end, are identical or are too long to bother.
+static bool changed_span(std::string_view a, std::string_view b, size_t &prefix, size_t &suffix)
+{
+    if (a.size() > WORD_DIFF_MAX_LINE || b.size() > WORD_DIFF_MAX_LINE)
+        return false;
+
+    size_t shorter = std::min(a.size(), b.size());
+    prefix = 0;
+    while (prefix < shorter && a[prefix] == b[prefix])
+        prefix++;
+    suffix = 0;
+    while (suffix < shorter - prefix && a[a.size() - 1 - suffix] == b[b.size() - 1 - suffix])
+        suffix++;
+
+    if (prefix + suffix == a.size() && prefix + suffix == b.size())
+        return false;
+
+    auto changed_word_char = [&](size_t pos) {
+        return (pos < a.size() - suffix && is_word_char(a[pos])) ||
+            (pos < b.size() - suffix && is_word_char(b[pos]));
+    };
+    if (prefix && is_word_char(a[prefix - 1]) && changed_word_char(prefix)) {
+        while (prefix && is_word_char(a[prefix - 1]))
+            prefix--;
+    }
+
+    auto changed_word_char_before = [&](size_t suffix) {
+        size_t a_pos = a.size() - suffix, b_pos = b.size() - suffix;
+        return (a_pos > prefix && is_word_char(a[a_pos - 1])) ||
+            (b_pos > prefix && is_word_char(b[b_pos - 1]));
+    };
+    if (suffix && is_word_char(a[a.size() - suffix]) && changed_word_char_before(suffix)) {
+        while (suffix && is_word_char(a[a.size() - suffix]))
+            suffix--;
+    }
+
+    return prefix || suffix;
+}
+
+static void mark_changes(diff_printer_passthrough::PendingLine &deleted,
+        diff_printer_passthrough::PendingLine &added)
+{
+    std::string_view old_text = diff_line_text(deleted.content);
+    std::string_view new_text = diff_line_text(added.content);
+
+    size_t prefix, suffix;
+    if (!changed_span(old_text, new_text, prefix, suffix))
+        return;
 
+    deleted.marked = added.marked = true;
+    deleted.mark = { prefix, old_text.size() - suffix, DIFF_CHANGED_MARKUP.open, DIFF_CHANGED_MARKUP.close };
+    added.mark = { prefix, new_text.size() - suffix, DIFF_CHANGED_MARKUP.open, DIFF_CHANGED_MARKUP.close };
+}
+
+static void hold_change(diff_printer_passthrough *passthrough, const git_diff_line *line)
+{
+    auto &pending = passthrough->pending;
+    if (passthrough->pending_count == pending.size())
+        pending.emplace_back();
+
+    auto &held = pending[passthrough->pending_count++];
+    held.origin = line->origin;
+    held.old_lineno = line->old_lineno;
+    held.new_lineno = line->new_lineno;
+    held.content.assign(line->content, line->content_len);
+    held.marked = false;
+    passthrough->pending_bytes += line->content_len;
+}
+
+// Prints the held run of deleted and added lines, pairing them in order.
+static void flush_changes(diff_printer_passthrough *passthrough)
+{
+    auto &pending = passthrough->pending;
+    size_t count = passthrough->pending_count;
+
+    size_t added = 0;
+    for (size_t deleted = 0; deleted < count; deleted++) {
+        if (pending[deleted].origin != GIT_DIFF_LINE_DELETION)
+            continue;
+        while (added < count && pending[added].origin != GIT_DIFF_LINE_ADDITION)
+            added++;
+        if (added == count)
+            break;
+        mark_changes(pending[deleted], pending[added++]);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        git_diff_line line {};
+        line.origin = pending[i].origin;
+        line.old_lineno = pending[i].old_lineno;
+        line.new_lineno = pending[i].new_lineno;
+        line.content = pending[i].content.data();
+        line.content_len = pending[i].content.size();
+        print_diff_line(passthrough, &line, pending[i].marked ? &pending[i].mark : nullptr);
+        pending[i].text_begin = passthrough->text_begin;
+        pending[i].text_end = passthrough->text_end;
+    }
+
+    // side by side, deleted and added lines are paired in the same order;
+    // the "\\ No newline at end of file" lines are left out
+    if (passthrough->split) {
+        size_t deleted = 0, added = 0;
+        while (true) {
+            while (deleted < count && pending[deleted].origin != GIT_DIFF_LINE_DELETION)
+                deleted++;
+            while (added < count && pending[added].origin != GIT_DIFF_LINE_ADDITION)
+                added++;
+            if (deleted == count && added == count)
+                break;
+
+            SplitCell old_cell {}, new_cell {};
+            if (deleted < count) {
+                auto &line = pending[deleted++];
+                old_cell = { line.old_lineno, "diff_del", line.text_begin, line.text_end };
+            }
+            if (added < count) {
+                auto &line = pending[added++];
+                new_cell = { line.new_lineno, "diff_add", line.text_begin, line.text_end };
+            }
+            print_split_row(passthrough,
+                old_cell.kind ? &old_cell : nullptr,
+                new_cell.kind ? &new_cell : nullptr);
+        }
+    }
+
+    passthrough->pending_count = 0;
+    passthrough->pending_bytes = 0;
+}
+
+// Vendored, generated, minified and LFS files get a line of how much
+// changed in place of their diff, and the rest of their lines are skipped.
+static void print_diff_summary(diff_printer_passthrough *passthrough, const git_diff_delta *delta)
+{
+    passthrough->skip_file = false;
+    for (auto &summary : passthrough->summaries) {
+        if (summary.delta != delta)
+            continue;
+
+        std::string &html = passthrough->html;
+        size_t begin = html.size();
+        diff_summary_template.render(html, {
+            content_class_name(summary.content_class),
+            summary.gain,
+            summary.loss,
+        });
+        if (passthrough->split)
+            passthrough->split->append(html, begin, html.size() - begin);
+        passthrough->skip_file = true;
+        return;
+    }
+}
+
+static int diff_printer(const git_diff_delta *delta, const git_diff_hunk *,
+        const git_diff_line *line, void *void_pass)
+{
+    diff_printer_passthrough *passthrough = (diff_printer_passthrough *)void_pass;
+    std::string &html = passthrough->html;
+    if (passthrough->skip_file && line->origin != GIT_DIFF_LINE_FILE_HDR)
+        return 0;
+    if (++passthrough->line_no >= passthrough->max_line_no) {
+        flush_changes(passthrough);
+        passthrough->finish(diff_max_line_count);
+        return 1;
+    }
+    size_t split_size = passthrough->split ? passthrough->split->size() : 0;
+    if (html.size() + split_size + passthrough->pending_bytes + line->content_len >= passthrough->max_bytes) {
+        flush_changes(passthrough);
+        passthrough->finish(diff_budget_reached);
+        passthrough->over_budget = true;
+        return 1;
+    }
+
+    switch (line->origin) {
+    case GIT_DIFF_LINE_ADDITION:
+    case GIT_DIFF_LINE_DELETION:
+    case GIT_DIFF_LINE_ADD_EOFNL:
+    case GIT_DIFF_LINE_DEL_EOFNL:
+        hold_change(passthrough, line);
+        return 0;
+    }
+    flush_changes(passthrough);
+
+    if (line->origin == GIT_DIFF_LINE_HUNK_HDR) {
+        passthrough->close_hunk();
+        if (passthrough->split)
+            print_split_hunk_hdr(passthrough, passthrough->line_hunk_hdr_no, line);
+        print_hunk_hdr(passthrough, line);
+        start_diff_hunk(passthrough);
+        if (passthrough->compact) {
+            html += DIFF_HUNK_COMPACT_MARKUP.open;
+            passthrough->in_hunk = true;
+        }
+        return 0;
+    }
+
+    if (line->origin == GIT_DIFF_LINE_FILE_HDR) {
+        passthrough->close_hunk();
+        if (passthrough->highlight)
+            start_diff_file(passthrough, delta);
+    }
+
+    size_t line_begin = html.size();
+    print_diff_line(passthrough, line, nullptr);
+
+    if (passthrough->split) {
+        if (line->origin == GIT_DIFF_LINE_CONTEXT) {
+            SplitCell old_cell { line->old_lineno, "diff_line", passthrough->text_begin, passthrough->text_end };
+            SplitCell new_cell { line->new_lineno, "diff_line", passthrough->text_begin, passthrough->text_end };
+            print_split_row(passthrough, &old_cell, &new_cell);
+        } else if (line->origin == GIT_DIFF_LINE_FILE_HDR) {
+            // the same file header markup as the unified view
+            passthrough->close_split_table();
+            passthrough->split->append(html, line_begin, html.size() - line_begin);
+        }
+    }
+
+    if (line->origin == GIT_DIFF_LINE_FILE_HDR && !passthrough->summaries.empty())
+        print_diff_summary(passthrough, delta);
     return 0;
 }
 
 void RepoHtmlGen::get_commit_info(git_commit *commit, CommitInfo &info)
 {
     info.commit = commit;
-    info.time = git_commit_time(commit);
     info.summary = git_commit_summary(commit);
     info.message = git_commit_message(commit);
     info.author = git_commit_author(commit);
+    // the author date, when the change was made, as git log shows it
+    info.time = info.author->when.time;
+    info.time_offset = info.author->when.offset;
     info.committer = git_commit_committer(commit);
     info.id = git_commit_id(commit);
     git_oid_tostr(info.id_str, sizeof(info.id_str), info.id);
@@ -432,6 +1366,9 @@ void RepoHtmlGen::get_commit_info(git_commit *commit, CommitInfo &info)
         if (delta->flags & GIT_DIFF_FLAG_BINARY)
             continue;
 
+        // the lines are at hand anyway, for the line lengths of the diff
+        LineStats line_stats;
+
         size_t hunks_count = git_patch_num_hunks(delta_obj.patch);
         for (size_t j = 0; j < hunks_count; j++) {
             const git_diff_hunk *current_hunk;
@@ -441,6 +1378,10 @@ void RepoHtmlGen::get_commit_info(git_commit *commit, CommitInfo &info)
             if (git_patch_get_hunk(&current_hunk, &current_hunk_lines, delta_obj.patch, j) < 0)
                 error("failed to get hunk from patch");
             for (size_t k = 0; !git_patch_get_line_in_hunk(&current_line, delta_obj.patch, j, k); k++) {
+                if (m_options.classify) {
+                    std::string_view content(current_line->content, current_line->content_len);
+                    line_stats.add(content);
+                }
                 if (current_line->old_lineno == -1) {
                     delta_obj.gain++;
                     info.gain++;
@@ -452,34 +1393,114 @@ void RepoHtmlGen::get_commit_info(git_commit *commit, CommitInfo &info)
         }
 
         info.hunks += hunks_count;
+
+        if (m_options.classify) {
+            if (is_lfs_delta(delta))
+                delta_obj.content_class = ContentClass::LfsPointer;
+            else if (auto content_class = classify_path(m_repo, delta->new_file.path))
+                delta_obj.content_class = *content_class;
+            else if (line_stats.minified())
+                delta_obj.content_class = ContentClass::Minified;
+            if (delta_obj.content_class != ContentClass::Normal)
+                m_classified.diffs++;
+        }
     }
 }
 
-void RepoHtmlGen::generate_commit_page(const CommitInfo &info)
+// Whether the file a delta leaves behind (or removes) is a Git LFS pointer.
+// The first line of a diff is not enough to tell: a hunk of a pointer need
+// not start at its version line, and a file may just quote one.
+bool RepoHtmlGen::is_lfs_delta(const git_diff_delta *delta)
 {
-    std::ofstream out_stream("public/" + m_repo_name + "/commits/" + info.id_str + ".html", std::ios::out);
-    if (!out_stream.is_open())
-        error("failed to open output file.");
+    const git_diff_file &file = delta->status == GIT_DELTA_DELETED ? delta->old_file : delta->new_file;
+    // the size is known once the patch has loaded the blob
+    if (file.size >= LFS_POINTER_MAX_SIZE)
+        return false;
+
+    git_blob *blob;
+    if (git_blob_lookup(&blob, m_repo, &file.id) < 0)
+        return false;
+    bool lfs_pointer = is_lfs_pointer({ (const char *)git_blob_rawcontent(blob), git_blob_rawsize(blob) });
+    git_blob_free(blob);
+    return lfs_pointer;
+}
 
+void RepoHtmlGen::generate_commit_page(const CommitInfo &info)
+{
     size_t diff_size_est =
         std::min(info.gain + info.loss + info.files * 4 + info.hunks, m_options.max_diff_lines) * LINE_SIZE_EST;
 
-    diff_printer_passthrough passthrough(m_options.max_diff_lines);
-    passthrough.html.reserve(diff_size_est);
-    git_diff_print(info.diff, GIT_DIFF_FORMAT_PATCH, &diff_printer, &passthrough);
+    // the diff is printed straight into the page and gets whatever is left
+    // of the output budget, so the oldest commits are the first to lose theirs
+    // the side-by-side view is built in the same pass, from the same lines
+    std::string split_diff;
+    std::string commit_path = "public/" + m_repo_name + "/commits/" + info.id_str;
+
+    auto write_diff = [&](std::string &out) {
+        if (m_options.split_diffs)
+            diff_view_link_template.render(out, { fmt::format("{}.split.html", info.id_str), "split view" });
+
+        diff_printer_passthrough passthrough(out, m_options.max_diff_lines, m_output.available(),
+            m_options.compact, m_options.highlight);
+        if (m_options.split_diffs) {
+            split_diff.reserve(diff_size_est);
+            passthrough.split = &split_diff;
+        }
+        for (auto &delta : info.deltas) {
+            if (delta.content_class != ContentClass::Normal)
+                passthrough.summaries.push_back({
+                    git_patch_get_delta(delta.patch), delta.content_class, delta.gain, delta.loss });
+        }
+        git_diff_print(info.diff, GIT_DIFF_FORMAT_PATCH, &diff_printer, &passthrough);
+        flush_changes(&passthrough);
+        passthrough.close_hunk();
+        if (passthrough.split)
+            passthrough.close_split_table();
+        if (passthrough.over_budget)
+            m_degraded.diffs++;
+    };
+
+    std::string page;
+    page.reserve(diff_size_est + commit_page_template.literal_size() + m_header_content.size());
+    commit_page_template.render(page, {
+        m_repo_name,
+        m_header_content,
+        m_dates.format(info.time, info.time_offset),
+        escape_string(info.message),
+        escape_string(info.author->name),
+        escape_string(info.author->email),
+        info.id_str,
+        info.parent_id_str,
+        write_diff,
+    });
+
+    bool written = m_output.write(commit_path + ".html", std::move(page), PageKind::Commit);
+
+    if (written && m_options.split_diffs) {
+        auto write_split = [&](std::string &out) {
+            diff_view_link_template.render(out, { fmt::format("{}.html", info.id_str), "unified view" });
+            out += split_diff;
+        };
+
+        std::string split_page;
+        split_page.reserve(split_diff.size() + commit_page_template.literal_size() + m_header_content.size());
+        commit_page_template.render(split_page, {
+            m_repo_name,
+            m_header_content,
+            m_dates.format(info.time, info.time_offset),
+            escape_string(info.message),
+            escape_string(info.author->name),
+            escape_string(info.author->email),
+            info.id_str,
+            info.parent_id_str,
+            write_split,
+        });
+
+        written = m_output.write(commit_path + ".split.html", std::move(split_page), PageKind::Commit);
+    }
 
-    out_stream << fmt::format(
-        commit_page_template,
-        fmt::arg("repo_name", m_repo_name),
-        fmt::arg("header_content", m_header_content),
-        fmt::arg("date", to_string(info.time)),
-        fmt::arg("message", escape_string(info.message)),
-        fmt::arg("author", escape_string(info.author->name)),
-        fmt::arg("email", escape_string(info.author->email)),
-        fmt::arg("commit", info.id_str),
-        fmt::arg("parent", info.parent_id_str),
-        fmt::arg("diff_content", passthrough.html)
-    );
+    if (!written)
+        error("failed to write output file.");
 }
 
 RepoHtmlGen::CommitInfo::~CommitInfo()
@@ -495,10 +1516,6 @@ RepoHtmlGen::CommitInfo::~CommitInfo()
 
 void RepoHtmlGen::generate_commit_pages()
 {
-    fs::path commits_dir = "public/" + m_repo_name + "/commits/";
-    if (!fs::exists(commits_dir))
-        fs::create_directories(commits_dir);
-
     git_revwalk *walk;
     git_oid oid;
 
@@ -519,7 +1536,7 @@ void RepoHtmlGen::generate_commit_pages()
     git_revwalk_simplify_first_parent(walk);
 
     std::string commits_html;
-    commits_html.reserve(m_options.max_commits * sizeof(commits_line_template));
+    commits_html.reserve(m_options.max_commits * commits_line_template.literal_size());
 
     while (git_revwalk_next(&oid, walk) == 0) {
         git_commit *commit;
@@ -530,28 +1547,28 @@ void RepoHtmlGen::generate_commit_pages()
         get_commit_info(commit, commit_info);
         generate_commit_page(commit_info);
 
-        commits_html += fmt::format(
-            commits_line_template,
-            fmt::arg("files", commit_info.files),
-            fmt::arg("gain", commit_info.gain),
-            fmt::arg("loss", commit_info.loss),
-            fmt::arg("commit_link", '/' + m_repo_name + "/commits/" + commit_info.id_str + ".html"),
-            fmt::arg("date", to_string(commit_info.time)),
-            fmt::arg("author", escape_string(commit_info.author->name)),
-            fmt::arg("summary", escape_string(commit_info.summary))
-        );
+        auto write_date = [&](std::string &out) {
+            m_dates.format(out, commit_info.time, commit_info.time_offset);
+        };
+        commits_line_template.render(commits_html, {
+            commit_info.files,
+            commit_info.gain,
+            commit_info.loss,
+            '/' + m_repo_name + "/commits/" + commit_info.id_str + ".html",
+            write_date,
+            escape_string(commit_info.author->name),
+            escape_string(commit_info.summary),
+        });
     }
 
     git_revwalk_free(walk);
 
-    std::ofstream out_stream("public/" + m_repo_name + "/commits.html", std::ios::out);
-    if (!out_stream.is_open())
-        error("failed to open output file.");
+    bool written = m_output.write("public/" + m_repo_name + "/commits.html", commits_page_template.format({
+        m_repo_name,
+        m_header_content,
+        commits_html,
+    }), PageKind::Index);
 
-    out_stream << fmt::format(
-        commits_page_template,
-        fmt::arg("repo_name", m_repo_name),
-        fmt::arg("header_content", m_header_content),
-        fmt::arg("commits_content", commits_html)
-    );
+    if (!written)
+        error("failed to write output file.");
 }
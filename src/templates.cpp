@@ -1,46 +1,127 @@
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <fmt/core.h>
 #include "templates.h"
 
-const char *header_template =
+namespace fs = std::filesystem;
+
+static constexpr TemplateDef<4> header_def {
 #include "templates/header.inc"
-;
+    , { "repo_name", "repo_desc", "files_path", "commits_path" }
+};
+Template<4> header_template = make_template<header_def>();
 
-const char *index_page_template =
+static constexpr TemplateDef<1> index_page_def {
 #include "templates/index.inc"
-;
+    , { "repos_content" }
+};
+Template<1> index_page_template = make_template<index_page_def>();
 
-const char *file_page_template = 
+static constexpr TemplateDef<4> file_page_def {
 #include "templates/file.inc"
-;
+    , { "header_content", "repo_name", "filename", "fileview_content" }
+};
+Template<4> file_page_template = make_template<file_page_def>();
 
-const char *file_view_template =
+static constexpr TemplateDef<5> file_view_def {
 #include "templates/file_view.inc"
-;
+    , { "filename", "raw_link", "file_content", "file_size", "file_size_unit" }
+};
+Template<5> file_view_template = make_template<file_view_def>();
+
+static constexpr TemplateDef<5> file_view_compact_def {
+#include "templates/file_view_compact.inc"
+    , { "filename", "raw_link", "file_content", "file_size", "file_size_unit" }
+};
+Template<5> file_view_compact_template = make_template<file_view_compact_def>();
+
+static constexpr TemplateDef<2> file_line_def {
+    "<li id=\"L{line_no}\"><pre>{line}</pre></li>",
+    { "line_no", "line" }
+};
+Template<2> file_line_template = make_template<file_line_def>();
+// the newline comes first, a newline right after <pre> is dropped by parsers
+// while one before </pre> would add an empty line
+static constexpr TemplateDef<2> file_line_compact_def {
+    "\n<a id=\"L{line_no}\">{line}</a>",
+    { "line_no", "line" }
+};
+Template<2> file_line_compact_template = make_template<file_line_compact_def>();
+
+static constexpr TemplateDef<7> file_chunk_view_def {
+#include "templates/file_chunk_view.inc"
+    , { "filename", "raw_link", "chunk_nav", "file_content", "file_size", "file_size_unit", "line_offset" }
+};
+Template<7> file_chunk_view_template = make_template<file_chunk_view_def>();
+
+static constexpr TemplateDef<7> file_chunk_view_compact_def {
+#include "templates/file_chunk_view_compact.inc"
+    , { "filename", "raw_link", "chunk_nav", "file_content", "file_size", "file_size_unit", "line_offset" }
+};
+Template<7> file_chunk_view_compact_template = make_template<file_chunk_view_compact_def>();
+
+static constexpr TemplateDef<4> file_chunk_nav_def {
+    "<div class=\"chunk_nav\">Lines {first}&ndash;{last} of {lines} {links}</div>",
+    { "links", "first", "last", "lines" }
+};
+Template<4> file_chunk_nav_template = make_template<file_chunk_nav_def>();
+static constexpr TemplateDef<2> file_chunk_link_def {
+    "<a href=\"{link}\">{label}</a> ",
+    { "link", "label" }
+};
+Template<2> file_chunk_link_template = make_template<file_chunk_link_def>();
+
+static constexpr TemplateDef<3> file_lfs_card_def {
+    "<div class=\"lfs_card\">Stored with Git LFS<br>"
+    "Object: <code>{oid}</code><br>Size: {size} {size_unit}</div>",
+    { "oid", "size", "size_unit" }
+};
+Template<3> file_lfs_card_template = make_template<file_lfs_card_def>();
 
-const char *file_line_template =
-    "<li><pre>{line}</pre></li>";
+static constexpr TemplateDef<1> file_raw_link_def {
+    "<a id=\"raw_link\" href=\"{raw_path}\">raw</a>",
+    { "raw_path" }
+};
+Template<1> file_raw_link_template = make_template<file_raw_link_def>();
 
-const char *file_index_template =
+static constexpr TemplateDef<5> file_index_def {
 #include "templates/file_index.inc"
-;
+    , { "repo_name", "header_content", "readme_content", "tree_content", "tree_path" }
+};
+Template<5> file_index_template = make_template<file_index_def>();
 
-const char *file_tree_line_template =
+static constexpr TemplateDef<4> file_tree_line_def {
     "<tr><td class=\"filename\"><a href=\"{file_tree_link}\">{file_tree_name}</a>"
-    "</td><td class=\"filesize\">{file_tree_size}</td><td class=\"sizeunit\">{file_tree_size_unit}</td></tr>";
-const char *file_tree_line_dir_template =
+    "</td><td class=\"filesize\">{file_tree_size}</td><td class=\"sizeunit\">{file_tree_size_unit}</td></tr>",
+    { "file_tree_name", "file_tree_size", "file_tree_size_unit", "file_tree_link" }
+};
+Template<4> file_tree_line_template = make_template<file_tree_line_def>();
+static constexpr TemplateDef<2> file_tree_line_dir_def {
     "<tr><td class=\"filename\"><a href=\"{file_tree_link}\">{file_tree_name}</a>"
-    "</td><td class=\"filesize\"></td><td class=\"sizeunit\"></td></tr>";
+    "</td><td class=\"filesize\"></td><td class=\"sizeunit\"></td></tr>",
+    { "file_tree_name", "file_tree_link" }
+};
+Template<2> file_tree_line_dir_template = make_template<file_tree_line_dir_def>();
 
-const char *commits_page_template =
+static constexpr TemplateDef<3> commits_page_def {
 #include "templates/commits.inc"
-;
+    , { "repo_name", "header_content", "commits_content" }
+};
+Template<3> commits_page_template = make_template<commits_page_def>();
 
-const char *commit_page_template =
+static constexpr TemplateDef<9> commit_page_def {
 #include "templates/commit.inc"
-;
+    , { "repo_name", "header_content", "date", "message", "author", "email", "commit", "parent", "diff_content" }
+};
+Template<9> commit_page_template = make_template<commit_page_def>();
 
-const char *commits_line_template =
+static constexpr TemplateDef<7> commits_line_def {
     "<tr><td>{date}</td><td><a href=\"{commit_link}\">{summary}</a></td><td>{author}</td><td>{files}</td>"
-    "<td>{gain}</td><td>{loss}</td></tr>";
+    "<td>{gain}</td><td>{loss}</td></tr>",
+    { "files", "gain", "loss", "commit_link", "date", "author", "summary" }
+};
+Template<7> commits_line_template = make_template<commits_line_def>();
 
 const char *diff_line_template =
     "<pre class=\"diff_line\">{}</pre>";
@@ -56,13 +137,109 @@ const char *diff_file_hdr_template =
     "<pre class=\"diff_file_hdr\">{}</pre>";
 const char *diff_hunk_hdr_template =
     "<a id=\"hunk{}\" href=\"#hunk{}\"><pre class=\"diff_hunk_hdr\">{}</pre></a>";
+const char *diff_hunk_compact_template =
+    "<pre class=\"diff_hunk\">{}</pre>";
+const char *diff_add_run_template =
+    "<ins>{}</ins>";
+const char *diff_del_run_template =
+    "<del>{}</del>";
+const char *diff_changed_template =
+    "<mark>{}</mark>";
+
+const char *diff_split_begin =
+    "<table class=\"diff_split\"><colgroup><col class=\"ln\"><col><col class=\"ln\"><col></colgroup>\n";
+const char *diff_split_end =
+    "</table>\n";
+static constexpr TemplateDef<6> diff_split_row_def {
+    "<tr><td class=\"ln\">{old_no}</td><td class=\"{old_kind}\"><pre>{old_line}</pre></td>"
+    "<td class=\"ln\">{new_no}</td><td class=\"{new_kind}\"><pre>{new_line}</pre></td></tr>\n",
+    { "old_no", "old_kind", "old_line", "new_no", "new_kind", "new_line" }
+};
+Template<6> diff_split_row_template = make_template<diff_split_row_def>();
+static constexpr TemplateDef<2> diff_split_hunk_hdr_def {
+    "<tr class=\"diff_hunk_hdr\"><td colspan=\"4\"><a id=\"hunk{hunk}\" href=\"#hunk{hunk}\">{header}</a></td></tr>\n",
+    { "hunk", "header" }
+};
+Template<2> diff_split_hunk_hdr_template = make_template<diff_split_hunk_hdr_def>();
+static constexpr TemplateDef<2> diff_view_link_def {
+    "<div class=\"diff_view\"><a href=\"{link}\">{label}</a></div>\n",
+    { "link", "label" }
+};
+Template<2> diff_view_link_template = make_template<diff_view_link_def>();
+static constexpr TemplateDef<3> diff_summary_def {
+    "<div class=\"diff_summary\">Diff of {kind} file not shown: {gain} additions, {loss} deletions.</div>\n",
+    { "kind", "gain", "loss" }
+};
+Template<3> diff_summary_template = make_template<diff_summary_def>();
 const char *diff_max_line_count =
     "<div class=\"diff_max\">Max diff line count reached.</div>";
+const char *diff_budget_reached =
+    "<div class=\"diff_max\">Output size budget reached, diff truncated.</div>";
+const char *budget_file_omitted =
+    "File omitted, output size budget reached.";
 
-const char *index_line_template =
-    "<tr><td><a href=\"/{name}\">{name}</a></td><td>{desc}</td><td>{updated}</td></tr>";
+static constexpr TemplateDef<3> index_line_def {
+    "<tr><td><a href=\"/{name}\">{name}</a></td><td>{desc}</td><td>{updated}</td></tr>",
+    { "name", "desc", "updated" }
+};
+Template<3> index_line_template = make_template<index_line_def>();
 
 const char *markdown_pre =
     "<div id=\"markdown\">";
 const char *markdown_post =
     "</div>";
+
+template <size_t N>
+static bool load_template(const fs::path &dir, const char *name, Template<N> &templ)
+{
+    fs::path path = dir / (std::string(name) + ".html");
+    std::ifstream in_stream(path);
+    if (!in_stream.is_open())
+        return true;
+
+    std::ostringstream ss;
+    ss << in_stream.rdbuf();
+    std::string source = ss.str();
+    // built-in templates have no trailing newline, keep rows from gaining one
+    if (!source.empty() && source.back() == '\n')
+        source.pop_back();
+
+    if (const char *err = templ.load(std::move(source))) {
+        fmt::print(stderr, "Error occurred: template {}: {}\n", path.string(), err);
+        return false;
+    }
+    return true;
+}
+
+bool load_templates(const std::string &dir)
+{
+    if (!fs::is_directory(dir)) {
+        fmt::print(stderr, "Error occurred: template directory {} not found\n", dir);
+        return false;
+    }
+
+    return load_template(dir, "header", header_template)
+        && load_template(dir, "index", index_page_template)
+        && load_template(dir, "index_line", index_line_template)
+        && load_template(dir, "file", file_page_template)
+        && load_template(dir, "file_view", file_view_template)
+        && load_template(dir, "file_view_compact", file_view_compact_template)
+        && load_template(dir, "file_line", file_line_template)
+        && load_template(dir, "file_line_compact", file_line_compact_template)
+        && load_template(dir, "file_chunk_view", file_chunk_view_template)
+        && load_template(dir, "file_chunk_view_compact", file_chunk_view_compact_template)
+        && load_template(dir, "file_chunk_nav", file_chunk_nav_template)
+        && load_template(dir, "file_chunk_link", file_chunk_link_template)
+        && load_template(dir, "file_lfs_card", file_lfs_card_template)
+        && load_template(dir, "file_raw_link", file_raw_link_template)
+        && load_template(dir, "file_index", file_index_template)
+        && load_template(dir, "file_tree_line", file_tree_line_template)
+        && load_template(dir, "file_tree_line_dir", file_tree_line_dir_template)
+        && load_template(dir, "commits", commits_page_template)
+        && load_template(dir, "commit", commit_page_template)
+        && load_template(dir, "commits_line", commits_line_template)
+        && load_template(dir, "diff_split_row", diff_split_row_template)
+        && load_template(dir, "diff_split_hunk_hdr", diff_split_hunk_hdr_template)
+        && load_template(dir, "diff_view_link", diff_view_link_template)
+        && load_template(dir, "diff_summary", diff_summary_template);
+}